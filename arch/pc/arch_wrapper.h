@@ -17,12 +17,18 @@ extern "C" {
 #define local_irq_save(flags)       \
     do { } while (0)
 #define local_irq_restore(flags)    \
-    do { } while (0)
+    do { (void)(flags); } while (0)
 #define local_irq_enable()          \
     do { } while (0)
 #define local_irq_disable()         \
     do { } while (0)
 
+// no irqs on pc, for cd_spin_lock_irqsave with CD_SMP
+static inline uint32_t _local_irq_save(void)
+{
+    return 0;
+}
+
 
 uint32_t get_systick(void);
 
@@ -0,0 +1,299 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/serial.h>
+#include "cduart_linux.h"
+#include "cd_debug.h"
+
+
+static speed_t cduart_lx_speed(uint32_t baud)
+{
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+    default: return B0;
+    }
+}
+
+// raw 8n1, no flow control, non-blocking, read returns what is there
+int cduart_lx_open(cduart_lx_port_t *port)
+{
+    const char *name = port->dev->name;
+    struct termios tio;
+    struct serial_struct ss;
+
+    if (port->path) {
+        port->fd = open(port->path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (port->fd < 0) {
+            dn_error(name, "open %s: %s\n", port->path, strerror(errno));
+            return -1;
+        }
+    } else if (fcntl(port->fd, F_SETFL, fcntl(port->fd, F_GETFL) | O_NONBLOCK) < 0) {
+        dn_error(name, "set non-blocking: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (tcgetattr(port->fd, &tio) < 0) {
+        dn_error(name, "tcgetattr: %s\n", strerror(errno));
+        goto err;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (port->baud) {
+        speed_t spd = cduart_lx_speed(port->baud);
+        if (spd == B0) {
+            dn_error(name, "baud %u not supported\n", port->baud);
+            goto err;
+        }
+        cfsetispeed(&tio, spd);
+        cfsetospeed(&tio, spd);
+    }
+    if (tcsetattr(port->fd, TCSANOW, &tio) < 0) {
+        dn_error(name, "tcsetattr: %s\n", strerror(errno));
+        goto err;
+    }
+
+    // push rx bytes to the tty layer at once, e.g. usb serial latency timer, not supported by ptys
+    if (ioctl(port->fd, TIOCGSERIAL, &ss) == 0) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        if (ioctl(port->fd, TIOCSSERIAL, &ss) < 0)
+            dn_warn(name, "low latency not set\n");
+    }
+    tcflush(port->fd, TCIOFLUSH);
+    return 0;
+
+err:
+    if (port->path) {
+        close(port->fd);
+        port->fd = -1;
+    }
+    return -1;
+}
+
+
+// free the tx frames of a dead port, so the free pool is not drained by a removed tty
+static void cduart_lx_drop(cduart_lx_port_t *port)
+{
+    cduart_dev_t *dev = port->dev;
+    cd_frame_t *frm;
+
+    if (port->tx_pend) {
+        cd_frame_free(dev->free_head, port->tx_pend);
+        port->tx_pend = NULL;
+        port->drop_cnt++;
+    }
+    while ((frm = cd_tx_get(&dev->tx_head)) != NULL) {
+        cd_frame_free(dev->free_head, frm);
+        port->drop_cnt++;
+    }
+    port->tx_ofs = port->tx_len = 0;
+}
+
+static void cduart_lx_rx(cduart_lx_t *lx, cduart_lx_port_t *port)
+{
+    uint8_t buf[CDUART_LX_RX_CHUNK];
+    ssize_t ret = read(port->fd, buf, sizeof(buf));
+
+    if (ret > 0) {
+        port->rx_bytes += ret;
+        cduart_rx_handle(port->dev, buf, ret);
+    } else if (ret == 0 || (errno != EAGAIN && errno != EINTR)) {
+        // e.g. eio after the other side of a pty is closed, stop polling it
+        dn_error(port->dev->name, "read: %s, port removed\n", ret ? strerror(errno) : "eof");
+        port->err_cnt++;
+        port->dead = true;
+        port->pollout = false;
+        epoll_ctl(lx->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+        cduart_lx_drop(port);
+    }
+}
+
+// copy frames with crc into tx_buf, the frames are freed at once
+static void cduart_lx_fill(cduart_lx_port_t *port)
+{
+    cduart_dev_t *dev = port->dev;
+
+    while (true) {
+        cd_frame_t *frm = port->tx_pend ? port->tx_pend : cd_tx_get(&dev->tx_head);
+        if (!frm)
+            break;
+        unsigned len = frm->dat[2] + 5;
+        if (port->tx_len + len > CDUART_LX_TX_BUF) {
+            port->tx_pend = frm;
+            break;
+        }
+        port->tx_pend = NULL;
+        cd_cap_dev_frame(CD_CAP_TX, dev->cap_id, frm->dat);
+#ifdef CD_VERBOSE
+        char pbuf[52];
+        hex_dump_small(pbuf, frm->dat, frm->dat[2] + 3, 16);
+        dn_verbose(dev->name, "<- [%s]\n", pbuf);
+#endif
+        memcpy(port->tx_buf + port->tx_len, frm->dat, len - 2);
+        cduart_fill_crc(port->tx_buf + port->tx_len);
+        port->tx_len += len;
+        port->tx_frames++;
+        cd_frame_free(dev->free_head, frm);
+    }
+}
+
+static void cduart_lx_tx(cduart_lx_t *lx, cduart_lx_port_t *port)
+{
+    while (true) {
+        if (port->tx_ofs == port->tx_len) {
+            port->tx_ofs = port->tx_len = 0;
+            cduart_lx_fill(port);
+            if (!port->tx_len)
+                break;
+        }
+        ssize_t ret = write(port->fd, port->tx_buf + port->tx_ofs, port->tx_len - port->tx_ofs);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN) {
+                dn_error(port->dev->name, "write: %s, drop %d bytes\n",
+                        strerror(errno), port->tx_len - port->tx_ofs);
+                port->err_cnt++;
+                port->tx_ofs = port->tx_len;
+            }
+            break;
+        }
+        port->tx_ofs += ret;
+        port->tx_bytes += ret;
+    }
+
+    // wait for EPOLLOUT only while the tty buffer is full
+    bool pollout = port->tx_ofs != port->tx_len;
+    if (pollout != port->pollout) {
+        struct epoll_event ev = { .events = EPOLLIN | (pollout ? EPOLLOUT : 0), .data.ptr = port };
+        epoll_ctl(lx->epfd, EPOLL_CTL_MOD, port->fd, &ev);
+        port->pollout = pollout;
+    }
+}
+
+
+// drain the tx queues, wait for the ports up to timeout_ms, then handle rx and tx
+int cduart_lx_poll(cduart_lx_t *lx, int timeout_ms)
+{
+    struct epoll_event evs[CDUART_LX_EVENTS];
+
+    for (int i = 0; i < lx->num; i++) {
+        if (lx->ports[i].dead)
+            cduart_lx_drop(&lx->ports[i]); // frames queued after the removal
+        else if (!lx->ports[i].pollout)
+            cduart_lx_tx(lx, &lx->ports[i]);
+    }
+
+    int n = epoll_wait(lx->epfd, evs, CDUART_LX_EVENTS, timeout_ms);
+    if (n < 0)
+        return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < n; i++) {
+        cduart_lx_port_t *port = evs[i].data.ptr;
+        if (!port) {
+            uint64_t val;
+            if (read(lx->evfd, &val, sizeof(val)) < 0)
+                d_verbose("evfd: %s\n", strerror(errno));
+            continue;
+        }
+        if (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            cduart_lx_rx(lx, port);
+        if ((evs[i].events & EPOLLOUT) && !port->dead)
+            cduart_lx_tx(lx, port);
+    }
+    return n;
+}
+
+// wake up cduart_lx_poll, e.g. after cd_tx_put from another thread
+void cduart_lx_kick(cduart_lx_t *lx)
+{
+    uint64_t val = 1;
+    if (write(lx->evfd, &val, sizeof(val)) < 0)
+        d_verbose("kick: %s\n", strerror(errno));
+}
+
+
+// close the fd of the ports opened by path, keep the fd passed in
+void cduart_lx_deinit(cduart_lx_t *lx)
+{
+    for (int i = 0; i < lx->num; i++) {
+        cduart_lx_port_t *port = &lx->ports[i];
+        if (port->tx_pend) {
+            cd_frame_free(port->dev->free_head, port->tx_pend);
+            port->tx_pend = NULL;
+        }
+        if (port->path && port->fd >= 0) {
+            close(port->fd);
+            port->fd = -1;
+        }
+    }
+    if (lx->evfd >= 0)
+        close(lx->evfd);
+    if (lx->epfd >= 0)
+        close(lx->epfd);
+    lx->evfd = lx->epfd = -1;
+    lx->num = 0;
+}
+
+// ports: dev, path or fd, baud set by caller, dev init by cduart_dev_init
+int cduart_lx_init(cduart_lx_t *lx, cduart_lx_port_t *ports, int num)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+
+    lx->ports = ports;
+    lx->num = 0;
+    lx->epfd = epoll_create1(EPOLL_CLOEXEC);
+    lx->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (lx->epfd < 0 || lx->evfd < 0 || epoll_ctl(lx->epfd, EPOLL_CTL_ADD, lx->evfd, &ev) < 0) {
+        d_error("cduart_lx: epoll init: %s\n", strerror(errno));
+        goto err;
+    }
+
+    for (int i = 0; i < num; i++) {
+        cduart_lx_port_t *port = &ports[i];
+        port->tx_pend = NULL;
+        port->tx_len = port->tx_ofs = 0;
+        port->pollout = false;
+        port->dead = false;
+        if (cduart_lx_open(port) < 0)
+            goto err;
+        lx->num++;
+        ev.data.ptr = port;
+        if (epoll_ctl(lx->epfd, EPOLL_CTL_ADD, port->fd, &ev) < 0) {
+            dn_error(port->dev->name, "epoll add: %s\n", strerror(errno));
+            goto err;
+        }
+    }
+    return 0;
+
+err:
+    cduart_lx_deinit(lx);
+    return -1;
+}
@@ -0,0 +1,76 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CDUART_LINUX_H__
+#define __CDUART_LINUX_H__
+
+#include "cdbus_uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// linux tty backend of cduart_dev_t: raw mode, non-blocking, all ports driven by one epoll loop
+//
+// single thread: call cduart_lx_poll() from the same loop as cdn_poll(),
+// cd_tx_put from other threads requires CD_SMP (real locks for tx_head),
+// then call cduart_lx_kick() after it to wake up the epoll_wait
+
+#ifndef CDUART_LX_RX_CHUNK
+#define CDUART_LX_RX_CHUNK  4096    // read() size passed to cduart_rx_handle
+#endif
+#ifndef CDUART_LX_TX_BUF
+#define CDUART_LX_TX_BUF    4096    // tx staging per port, frames are copied with crc
+#endif
+#if CDUART_LX_TX_BUF < CD_FRAME_SIZE + 2
+#error "CDUART_LX_TX_BUF must hold a full size frame with crc"
+#endif
+#ifndef CDUART_LX_EVENTS
+#define CDUART_LX_EVENTS    16
+#endif
+
+typedef struct {
+    cduart_dev_t    *dev;
+    const char      *path;          // tty device, NULL: use fd (e.g. from openpty)
+    int             fd;
+    uint32_t        baud;           // 0: keep the current speed
+
+    cd_frame_t      *tx_pend;       // no room in tx_buf
+    uint16_t        tx_len;
+    uint16_t        tx_ofs;         // written bytes of tx_buf
+    bool            pollout;        // EPOLLOUT armed
+    bool            dead;           // removed from epoll after a read error, tx frames are dropped
+    uint8_t         tx_buf[CDUART_LX_TX_BUF];
+
+    uint32_t        rx_bytes;
+    uint32_t        tx_bytes;
+    uint32_t        tx_frames;
+    uint32_t        err_cnt;        // read / write errors other than EAGAIN
+    uint32_t        drop_cnt;       // tx frames freed after the port is dead
+} cduart_lx_port_t;
+
+typedef struct {
+    int             epfd;
+    int             evfd;           // eventfd for cduart_lx_kick
+    cduart_lx_port_t *ports;
+    int             num;
+} cduart_lx_t;
+
+
+int cduart_lx_open(cduart_lx_port_t *port);
+int cduart_lx_init(cduart_lx_t *lx, cduart_lx_port_t *ports, int num);
+void cduart_lx_deinit(cduart_lx_t *lx);
+int cduart_lx_poll(cduart_lx_t *lx, int timeout_ms); // return events handled, < 0: error
+void cduart_lx_kick(cduart_lx_t *lx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
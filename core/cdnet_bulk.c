@@ -0,0 +1,236 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cdnet_bulk.h"
+#include "cd_debug.h"
+
+
+static inline bool cdn_bulk_need_reply(const cdn_bulk_tx_t *tx, uint32_t idx)
+{
+    return idx % tx->grp_size == tx->grp_size - 1u || idx == tx->pkt_cnt - 1;
+}
+
+static int cdn_bulk_tx_pkt(cdn_bulk_tx_t *tx, uint32_t idx)
+{
+    uint32_t ofs = idx * tx->chunk;
+    cdn_pkt_t *pkt = cdn_pkt_alloc(tx->ns);
+    if (!pkt)
+        return -1;
+
+    pkt->dst = tx->dst;
+    cdn_pkt_prepare(&tx->socks[idx & 7], pkt);
+    if (!cdn_bulk_need_reply(tx, idx))
+        pkt->src.port |= CDN_BULK_NO_REPLY; // header size unchanged
+    pkt->len = min(tx->total - ofs, (uint32_t)tx->chunk);
+
+    if (tx->buf) {
+        memcpy(pkt->dat, tx->buf + ofs, pkt->len);
+    } else if (tx->read(tx->arg, ofs, pkt->dat, pkt->len) < 0) {
+        cdn_pkt_free(tx->ns, pkt);
+        return -1;
+    }
+    cdn_send_pkt(tx->ns, pkt);
+    return 0;
+}
+
+static void cdn_bulk_tx_reply(cdn_bulk_tx_t *tx, uint8_t cnt, uint8_t status)
+{
+    uint32_t last;
+
+    // match the packet in flight which requires this reply
+    for (last = tx->ack_idx; last < tx->tx_idx; last++) {
+        if ((last & 7) == cnt && cdn_bulk_need_reply(tx, last))
+            break;
+    }
+    if (last == tx->tx_idx) {
+        d_verbose("bulk: stale reply: %d\n", cnt);
+        return;
+    }
+
+    uint32_t idx = last + 1;
+    if (status & CDN_BULK_ERR) {
+        // receiver waits for a packet in [last - 7, last]
+        uint32_t base = max(tx->ack_idx, last >= 7 ? last - 7 : 0);
+        idx = base + (((status & 7) - base) & 7);
+    }
+
+    if (idx > tx->ack_idx) {
+        tx->ack_idx = idx;
+        tx->rewinding = false;
+        tx->retry_cnt = 0;
+        if (idx == tx->pkt_cnt)
+            tx->t_end = get_systick();
+        if (tx->tx_idx != tx->ack_idx)
+            cd_timer_mod(tx->wheel, &tx->tm, tx->timeout);
+        else
+            cd_timer_del(&tx->tm);
+    }
+
+    // ignore further errors until the resent data is acked
+    if ((status & CDN_BULK_ERR) && !tx->rewinding) {
+        d_debug("bulk: err reply, resend from %"PRIu32"\n", tx->ack_idx);
+        tx->resend_cnt += tx->tx_idx - tx->ack_idx;
+        tx->tx_idx = tx->ack_idx;
+        tx->rewinding = true;
+    }
+}
+
+static void cdn_bulk_tx_timeout(cd_timer_t *tm)
+{
+    cdn_bulk_tx_t *tx = container_of(tm, cdn_bulk_tx_t, tm);
+
+    if (++tx->retry_cnt > tx->max_retry) {
+        d_debug("bulk: retry exceeded at %"PRIu32"\n", tx->ack_idx);
+        return; // reported by cdn_bulk_tx_poll
+    }
+    d_debug("bulk: timeout, resend from %"PRIu32"\n", tx->ack_idx);
+    tx->resend_cnt += tx->tx_idx - tx->ack_idx;
+    tx->tx_idx = tx->ack_idx;
+    tx->rewinding = true;
+}
+
+int cdn_bulk_tx_poll(cdn_bulk_tx_t *tx)
+{
+    for (int i = 0; i < 8; i++) {
+        cdn_pkt_t *pkt;
+        while ((pkt = cdn_sock_recvfrom(&tx->socks[i])) != NULL) {
+            if (pkt->len >= 1)
+                cdn_bulk_tx_reply(tx, i, pkt->dat[0]);
+            cdn_pkt_free(tx->ns, pkt);
+        }
+    }
+
+    if (tx->ack_idx == tx->pkt_cnt)
+        return 1;
+    if (tx->retry_cnt > tx->max_retry)
+        return -1;
+
+    // at most 7 packets in flight, so the 3-bit cnt is never ambiguous
+    while (tx->tx_idx < tx->pkt_cnt && tx->tx_idx - tx->ack_idx < 7 &&
+            tx->tx_idx / tx->grp_size < tx->ack_idx / tx->grp_size + tx->win) {
+        if (cdn_bulk_tx_pkt(tx, tx->tx_idx))
+            break; // no free pkt, retry at next poll
+        if (tx->tx_idx++ == tx->ack_idx)
+            cd_timer_mod(tx->wheel, &tx->tm, tx->timeout);
+    }
+    return 0;
+}
+
+void cdn_bulk_tx_start(cdn_bulk_tx_t *tx, const cdn_sockaddr_t *dst, uint32_t total)
+{
+    tx->dst = *dst;
+    tx->total = total;
+    tx->pkt_cnt = (total + tx->chunk - 1) / tx->chunk;
+    tx->ack_idx = 0;
+    tx->tx_idx = 0;
+    tx->rewinding = false;
+    tx->retry_cnt = 0;
+    tx->resend_cnt = 0;
+    tx->t_start = tx->t_end = get_systick();
+    cd_timer_del(&tx->tm);
+}
+
+uint32_t cdn_bulk_tx_rate(const cdn_bulk_tx_t *tx)
+{
+    uint32_t bytes = min(tx->ack_idx * tx->chunk, tx->total);
+    uint32_t t = (tx->ack_idx == tx->pkt_cnt ? tx->t_end : get_systick()) - tx->t_start;
+    if (!t)
+        return 0;
+    return (uint64_t)bytes * 1000000 / ((uint64_t)t * CD_SYSTICK_US_DIV);
+}
+
+// port_base: 0x40 ~ 0x78, multiple of 8
+int cdn_bulk_tx_init(cdn_bulk_tx_t *tx, cdn_ns_t *ns, cd_timer_wheel_t *wheel, uint8_t port_base)
+{
+    cdn_assert(port_base >= 0x40 && port_base < 0x80 && !(port_base & 7));
+    tx->ns = ns;
+    tx->wheel = wheel;
+    tx->tm.pprev = NULL;
+    tx->tm.cb = cdn_bulk_tx_timeout;
+    if (!tx->grp_size)
+        tx->grp_size = 5;
+    if (!tx->win)
+        tx->win = 2;
+    if (!tx->chunk)
+        tx->chunk = min(CD_FRAME_SIZE - 2 - 3 - 9, 240); // uart crc, frame and max level 1 header
+    if (!tx->timeout)
+        tx->timeout = 500000 / CD_SYSTICK_US_DIV; // 500 ms
+    if (!tx->max_retry)
+        tx->max_retry = 3;
+    cdn_assert(tx->grp_size <= 8);
+
+    for (int i = 0; i < 8; i++) {
+        memset(&tx->socks[i], 0, sizeof(cdn_sock_t));
+        tx->socks[i].ns = ns;
+        tx->socks[i].port = port_base | i;
+        if (cdn_sock_bind(&tx->socks[i])) {
+            while (i--)
+                cdn_sock_unbind(&tx->socks[i]);
+            return -1;
+        }
+    }
+    tx->ack_idx = tx->tx_idx = tx->pkt_cnt = 0;
+    return 0;
+}
+
+void cdn_bulk_tx_deinit(cdn_bulk_tx_t *tx)
+{
+    cd_timer_del(&tx->tm);
+    for (int i = 0; i < 8; i++) {
+        cdn_pkt_t *pkt;
+        cdn_sock_unbind(&tx->socks[i]);
+        while ((pkt = cdn_sock_recvfrom(&tx->socks[i])) != NULL)
+            cdn_pkt_free(tx->ns, pkt);
+    }
+}
+
+
+void cdn_bulk_rx_reset(cdn_bulk_rx_t *rx)
+{
+    rx->ofs = 0;
+    rx->cnt = 0;
+    rx->err = false;
+}
+
+// consume pkt received by sock, the pkt is reused for the reply
+int cdn_bulk_rx_handle(cdn_bulk_rx_t *rx, cdn_sock_t *sock, cdn_pkt_t *pkt)
+{
+    int ret = 0;
+
+    if ((pkt->src.port & 7) == rx->cnt) {
+        if (rx->buf && rx->ofs + pkt->len > rx->size) {
+            ret = -1; // overflow, never acked
+            rx->err = true;
+        } else {
+            if (rx->buf)
+                memcpy(rx->buf + rx->ofs, pkt->dat, pkt->len);
+            else
+                rx->write(rx->arg, rx->ofs, pkt->dat, pkt->len);
+            rx->ofs += pkt->len;
+            rx->cnt = (rx->cnt + 1) & 7;
+            rx->err = false;
+        }
+    } else {
+        if (!rx->err)
+            rx->err_cnt++;
+        rx->err = true; // discard until the expected cnt
+    }
+
+    if (pkt->src.port & CDN_BULK_NO_REPLY) {
+        cdn_pkt_free(sock->ns, pkt);
+        return ret;
+    }
+
+    pkt->dst = pkt->src;
+    cdn_pkt_prepare(sock, pkt);
+    pkt->dat[0] = rx->cnt | (rx->err ? CDN_BULK_ERR : 0);
+    pkt->len = 1;
+    cdn_sock_sendto(sock, pkt);
+    return ret;
+}
@@ -0,0 +1,89 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CDNET_BULK_H__
+#define __CDNET_BULK_H__
+
+#include "cdnet_core.h"
+#include "cd_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bulk transfer with packet groups (see Readme: Sequence & Flow Control)
+//
+// Sender ephemeral port: [7]: no reply, [6:3]: port_base, [2:0]: cnt
+// Only the last packet of each group (and the last packet) requires a reply.
+// Reply: [status], status[7]: error, status[2:0]: next cnt expected by the receiver
+// The receiver discards packets on cnt mismatch, the sender resumes from the expected cnt.
+// The no reply flag takes bit 7 of the src port, so level 1 is required.
+// The ack timeout is driven by the timer wheel, call cd_timer_run() in the main loop.
+
+#define CDN_BULK_NO_REPLY   0x80
+#define CDN_BULK_ERR        0x80
+
+typedef int (*cdn_bulk_read_t)(void *arg, uint32_t ofs, uint8_t *dat, int len);
+typedef void (*cdn_bulk_write_t)(void *arg, uint32_t ofs, const uint8_t *dat, int len);
+
+typedef struct {
+    cdn_ns_t        *ns;
+    cd_timer_wheel_t *wheel;
+    cdn_sock_t      socks[8];   // reply ports: port_base | cnt
+    cdn_sockaddr_t  dst;
+
+    uint8_t         grp_size;   // packets per group: 1 ~ 8
+    uint8_t         win;        // groups in flight
+    uint8_t         chunk;      // payload size per packet
+    uint8_t         max_retry;
+    uint32_t        timeout;    // unit: systick
+
+    const uint8_t   *buf;       // data source, or read callback if NULL
+    cdn_bulk_read_t read;
+    void            *arg;
+    uint32_t        total;
+
+    uint32_t        pkt_cnt;
+    uint32_t        ack_idx;    // first packet not acked
+    uint32_t        tx_idx;     // next packet to send
+    bool            rewinding;
+    uint8_t         retry_cnt;
+    cd_timer_t      tm;         // ack timeout, pending while packets are in flight
+    uint32_t        t_start;
+    uint32_t        t_end;
+    uint32_t        resend_cnt; // statistics
+} cdn_bulk_tx_t;
+
+typedef struct {
+    uint8_t         *buf;       // data destination, or write callback if NULL
+    cdn_bulk_write_t write;
+    void            *arg;
+    uint32_t        size;       // buf size
+
+    uint32_t        ofs;        // received bytes
+    uint8_t         cnt;        // next cnt expected
+    bool            err;
+    uint32_t        err_cnt;    // statistics
+} cdn_bulk_rx_t;
+
+
+int cdn_bulk_tx_init(cdn_bulk_tx_t *tx, cdn_ns_t *ns, cd_timer_wheel_t *wheel, uint8_t port_base);
+void cdn_bulk_tx_deinit(cdn_bulk_tx_t *tx);
+void cdn_bulk_tx_start(cdn_bulk_tx_t *tx, const cdn_sockaddr_t *dst, uint32_t total);
+int cdn_bulk_tx_poll(cdn_bulk_tx_t *tx); // return 0: busy, 1: finished, < 0: error
+uint32_t cdn_bulk_tx_rate(const cdn_bulk_tx_t *tx); // unit: byte/s
+
+void cdn_bulk_rx_reset(cdn_bulk_rx_t *rx);
+int cdn_bulk_rx_handle(cdn_bulk_rx_t *rx, cdn_sock_t *sock, cdn_pkt_t *pkt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -11,6 +11,122 @@
 #include "cd_debug.h"
 
 
+#ifdef CDN_ROUTE_MAX
+
+static inline unsigned cdn_route_hash(const uint8_t *addr)
+{
+    return (addr[2] ^ (addr[1] << 2) ^ (addr[0] >> 5)) & (CDN_ROUTE_CACHE_SIZE - 1);
+}
+
+static cdn_intf_t *cdn_route_lookup(cdn_ns_t *ns, const uint8_t *addr, uint8_t *mac)
+{
+    *mac = addr[2];
+
+    if (addr[0] == 0xf0) // multicast: mac layer multicast id: ml
+        return ns->route_dft.intf ? ns->route_dft.intf : &ns->intfs[0];
+
+    // directly connected
+    for (int i = 0; i < CDN_INTF_MAX; i++) {
+        cdn_intf_t *intf = &ns->intfs[i];
+        if (intf->dev && intf->net == addr[1])
+            return intf;
+    }
+
+    if (addr[0] != 0xa0) // local link
+        return &ns->intfs[0];
+
+    for (int i = 0; i < CDN_ROUTE_MAX; i++) {
+        cdn_route_t *rt = &ns->routes[i];
+        if (rt->intf && rt->net == addr[1]) {
+            *mac = rt->mac;
+            return rt->intf;
+        }
+    }
+
+    *mac = ns->route_dft.mac;
+    return ns->route_dft.intf;
+}
+
+static cdn_intf_t *cdn_route_get(cdn_ns_t *ns, const uint8_t *addr, uint8_t *mac)
+{
+    cdn_route_cache_t *c = &ns->route_cache[cdn_route_hash(addr)];
+
+    if (!c->intf || memcmp(c->addr, addr, 3)) {
+        cdn_intf_t *intf = cdn_route_lookup(ns, addr, &c->mac);
+        if (!intf) {
+            c->intf = NULL;
+            return NULL;
+        }
+        memcpy(c->addr, addr, 3);
+        c->intf = intf;
+    }
+    *mac = c->mac;
+    return c->intf;
+}
+
+__weak cdn_intf_t *cdn_route(cdn_ns_t *ns, cdn_pkt_t *pkt)
+{
+    uint8_t mac;
+    cdn_intf_t *intf = cdn_route_get(ns, pkt->dst.addr, &mac);
+
+    pkt->src.addr[0] = pkt->dst.addr[0] != 0xf0 ? pkt->dst.addr[0] : 0x80;
+    if (!intf)
+        return NULL;
+    pkt->src.addr[1] = intf->net;
+    pkt->src.addr[2] = intf->mac;
+    pkt->_s_mac = intf->mac;
+    pkt->_d_mac = mac;
+    return intf;
+}
+
+void cdn_route_flush_cache(cdn_ns_t *ns)
+{
+    memset(ns->route_cache, 0, sizeof(ns->route_cache));
+}
+
+int cdn_route_add(cdn_ns_t *ns, uint8_t net, cdn_intf_t *intf, uint8_t mac)
+{
+    cdn_route_t *empty = NULL;
+    for (int i = 0; i < CDN_ROUTE_MAX; i++) {
+        cdn_route_t *rt = &ns->routes[i];
+        if (rt->intf && rt->net == net) {
+            empty = rt;
+            break;
+        }
+        if (!rt->intf && !empty)
+            empty = rt;
+    }
+    if (!empty)
+        return -1;
+    empty->net = net;
+    empty->mac = mac;
+    empty->intf = intf;
+    cdn_route_flush_cache(ns);
+    return 0;
+}
+
+int cdn_route_del(cdn_ns_t *ns, uint8_t net)
+{
+    for (int i = 0; i < CDN_ROUTE_MAX; i++) {
+        cdn_route_t *rt = &ns->routes[i];
+        if (rt->intf && rt->net == net) {
+            rt->intf = NULL;
+            cdn_route_flush_cache(ns);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void cdn_route_set_dft(cdn_ns_t *ns, cdn_intf_t *intf, uint8_t mac)
+{
+    ns->route_dft.intf = intf;
+    ns->route_dft.mac = mac;
+    cdn_route_flush_cache(ns);
+}
+
+#else
+
 // simplified for basic use, override for full processing
 __weak cdn_intf_t *cdn_route(cdn_ns_t *ns, cdn_pkt_t *pkt)
 {
@@ -23,6 +139,77 @@ __weak cdn_intf_t *cdn_route(cdn_ns_t *ns, cdn_pkt_t *pkt)
     return intf;
 }
 
+#endif
+
+#ifdef CDN_SOCK_TBL_BITS
+
+#define CDN_SOCK_TBL_MASK   ((1 << CDN_SOCK_TBL_BITS) - 1)
+
+static inline unsigned cdn_sock_hash(uint16_t port)
+{
+    return (port * 0x9e3779b1u) >> (32 - CDN_SOCK_TBL_BITS);
+}
+
+static cdn_sock_t *cdn_sock_search(cdn_ns_t *ns, uint16_t port)
+{
+    unsigned i = cdn_sock_hash(port);
+    cdn_sock_t *sock;
+    while ((sock = ns->sock_tbl[i]) != NULL) {
+        if (sock->port == port)
+            return sock;
+        i = (i + 1) & CDN_SOCK_TBL_MASK;
+    }
+    return NULL;
+}
+
+static int cdn_sock_insert(cdn_sock_t *sock)
+{
+    cdn_ns_t *ns = sock->ns;
+    if (ns->sock_cnt >= CDN_SOCK_TBL_MASK) // keep at least one empty slot
+        return -1;
+    unsigned i = cdn_sock_hash(sock->port);
+    while (ns->sock_tbl[i]) {
+        if (ns->sock_tbl[i]->port == sock->port)
+            return -1;
+        i = (i + 1) & CDN_SOCK_TBL_MASK;
+    }
+    ns->sock_tbl[i] = sock;
+    ns->sock_cnt++;
+    return 0;
+}
+
+static int cdn_sock_remove(cdn_sock_t *sock)
+{
+    cdn_ns_t *ns = sock->ns;
+    unsigned i = cdn_sock_hash(sock->port);
+    while (ns->sock_tbl[i] != sock) {
+        if (!ns->sock_tbl[i])
+            return -1;
+        i = (i + 1) & CDN_SOCK_TBL_MASK;
+    }
+
+    // backward shift deletion, no tombstone
+    unsigned j = i;
+    while (true) {
+        ns->sock_tbl[i] = NULL;
+        while (true) {
+            j = (j + 1) & CDN_SOCK_TBL_MASK;
+            if (!ns->sock_tbl[j]) {
+                ns->sock_cnt--;
+                return 0;
+            }
+            unsigned k = cdn_sock_hash(ns->sock_tbl[j]->port);
+            // move back only if the home slot k is not within (i, j]
+            if (i <= j ? (k <= i || k > j) : (k <= i && k > j))
+                break;
+        }
+        ns->sock_tbl[i] = ns->sock_tbl[j];
+        i = j;
+    }
+}
+
+#else // simple list for small mcu
+
 static cdn_sock_t *cdn_sock_search(cdn_ns_t *ns, uint16_t port)
 {
     list_node_t *pos;
@@ -43,49 +230,248 @@ static int cdn_sock_insert(cdn_sock_t *sock)
     return 0;
 }
 
+static int cdn_sock_remove(cdn_sock_t *sock)
+{
+    list_node_t *pre, *pos;
+    list_for_each(&sock->ns->socks, pre, pos) {
+        if (pos == &sock->node) {
+            list_pick(&sock->ns->socks, pre, pos);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+#endif
+
 
-void cdn_poll(cdn_ns_t *ns)
+static void cdn_sock_rx(cdn_ns_t *ns, cdn_sock_t *sock, cdn_pkt_t *pkt)
 {
-    // rx
+    // pkt is already out of the pool, rx_cb takeovers included
+    if (sock->rx_policy != CDN_RX_RESERVE && cdn_pkt_free_len(ns) < ns->rx_reserved)
+        goto drop;
+    if (sock->rx_cb) {
+        sock->rx_cb(sock, pkt);
+        return;
+    }
+    if (sock->rx_policy == CDN_RX_RESERVE) {
+        if (sock->rx_head.len >= sock->rx_max)
+            goto drop;
+        if (sock->reserved)
+            ns->rx_reserved--;
+    } else {
+        if (sock->rx_max && sock->rx_head.len >= sock->rx_max) {
+            if (sock->rx_policy != CDN_RX_DROP_OLD)
+                goto drop;
+            cdn_pkt_free(ns, cdn_list_get(&sock->rx_head));
+            sock->rx_drop_cnt++;
+        }
+    }
+    cdn_list_put(&sock->rx_head, pkt);
+    return;
+
+drop:
+    d_verbose("cdn rx: sock %x full\n", sock->port);
+    sock->rx_drop_cnt++;
+    cdn_pkt_free(ns, pkt);
+}
+
+
+#ifdef CDN_FORWARD
+// return true if pkt->frm is not for local and has been consumed
+static bool cdn_forward(cdn_ns_t *ns, cdn_intf_t *intf, cdn_pkt_t *pkt)
+{
+    const uint8_t *addr = pkt->dst.addr;
+    if (addr[0] != 0xa0 || addr[1] == intf->net)
+        return false;
     for (int i = 0; i < CDN_INTF_MAX; i++) {
-        cdn_intf_t *intf = &ns->intfs[i];
-        cd_dev_t *dev = intf->dev;
+        if (ns->intfs[i].dev && ns->intfs[i].net == addr[1] && ns->intfs[i].mac == addr[2])
+            return false;
+    }
 
-        while (true) {
-            if (!ns->rx_tmp)
-                ns->rx_tmp = cdn_list_get(ns->free_pkt);
-            if (!ns->rx_tmp) {
-                d_warn("rx: no free pkt\n");
-                break;
+    uint8_t mac;
+    cdn_intf_t *out = cdn_route_get(ns, addr, &mac);
+    if (!out || out == intf) {
+        d_verbose("fwd: no route\n");
+        cd_frame_free(ns->free_frm, pkt->frm);
+        intf->fwd_drop_cnt++;
+    } else {
+        // the cross net header carries both full addresses, only the mac layer changes
+#ifdef CD_TX_PRIO_NUM
+        pkt->frm->prio = 0;
+#endif
+        pkt->frm->dat[0] = out->mac;
+        pkt->frm->dat[1] = mac;
+        cd_cap_frame(CD_CAP_TX, out - ns->intfs, pkt->frm->dat);
+        out->dev->send_frame(out->dev, pkt->frm);
+        intf->fwd_cnt++;
+    }
+    pkt->frm = NULL;
+    return true;
+}
+#endif
+
+
+#ifdef CDN_MCAST_MAX
+// members share pkt->frm, so the rx pkts are read only (not reusable for reply)
+static void cdn_mcast_rx(cdn_ns_t *ns, cdn_intf_t *intf, cdn_pkt_t *pkt)
+{
+    uint16_t group = pkt->dst.addr[1] << 8 | pkt->dst.addr[2];
+    cdn_sock_t *last = NULL;
+
+#ifdef CDN_FORWARD
+    // a frame fits in one tx queue only, and a cross net source is required for replies
+    for (int i = 0; i < CDN_MCAST_MAX && pkt->src.addr[0] == 0xa0; i++) {
+        cdn_mcast_t *m = &ns->mcast[i];
+        if (m->intf && m->intf != intf && m->group == group) {
+            cd_frame_ref(ns->free_frm, pkt->frm);
+#ifdef CD_TX_PRIO_NUM
+            pkt->frm->prio = 0;
+#endif
+            pkt->frm->dat[0] = m->intf->mac; // dat[1]: ml unchanged
+            cd_cap_frame(CD_CAP_TX, m->intf - ns->intfs, pkt->frm->dat);
+            m->intf->dev->send_frame(m->intf->dev, pkt->frm);
+            intf->fwd_cnt++;
+            break;
+        }
+    }
+#endif
+
+    for (int i = 0; i < CDN_MCAST_MAX; i++) {
+        cdn_mcast_t *m = &ns->mcast[i];
+        if (!m->sock || m->group != group || m->sock->port != pkt->dst.port || m->sock->tx_only)
+            continue;
+        if (last) {
+            cdn_pkt_t *n = cdn_pkt_clone(ns, pkt);
+            if (n) {
+                cdn_sock_rx(ns, last, n);
+            } else {
+                d_verbose("cdn rx: mcast no free pkt\n");
+                last->rx_drop_cnt++;
             }
+        }
+        last = m->sock;
+    }
 
-            cd_frame_t *frame = dev->recv_frame(dev);
-            if (!frame)
-                break;
-            cdn_pkt_t *pkt = ns->rx_tmp;
-            memset(pkt, 0, sizeof(cdn_pkt_t));
-            pkt->frm = frame;
-            pkt->_l_net = intf->net;
-
-            int ret = cdn_frame_r(pkt);
-            if (!ret) {
-                cdn_sock_t *sock = cdn_sock_search(ns, pkt->dst.port);
-                if (!ret && sock && !sock->tx_only) {
-                    cdn_list_put(&sock->rx_head, pkt);
-                } else {
-                    d_verbose("cdn rx: no sock\n");
-                    cdn_pkt_free(ns, pkt);
-                }
+    if (last) {
+        cdn_sock_rx(ns, last, pkt);
+    } else {
+        d_verbose("cdn rx: mcast no member\n");
+        cdn_pkt_free(ns, pkt);
+    }
+}
+#endif
+
+
+static inline void cdn_rx_err_cnt(cdn_intf_t *intf, int ret)
+{
+    if (ret == CDN_FRM_ERR_LEN)
+        intf->rx_len_err++;
+    else if (ret == CDN_FRM_ERR_SIZE)
+        intf->rx_size_err++;
+    else
+        intf->rx_hdr_err++; // including cdn_assert of the header decoders
+}
+
+static int cdn_poll_intf(cdn_ns_t *ns, cdn_intf_t *intf, int quota)
+{
+    cd_dev_t *dev = intf->dev;
+    int cnt = 0;
+
+    while (cnt < quota) {
+#ifdef CDN_PKT_IN_FRM
+        cd_frame_t *frame = dev->recv_frame(dev);
+        if (!frame)
+            break;
+        cnt++;
+        cdn_pkt_t *pkt = cdn_frm_pkt(frame); // rx_tmp not used
+#else
+        if (!ns->rx_tmp)
+            ns->rx_tmp = cdn_list_get(ns->free_pkt);
+        if (!ns->rx_tmp) {
+            d_warn("rx: no free pkt\n");
+            break;
+        }
+
+        cd_frame_t *frame = dev->recv_frame(dev);
+        if (!frame)
+            break;
+        cnt++;
+        cdn_pkt_t *pkt = ns->rx_tmp;
+#endif
+        cd_cap_frame(CD_CAP_RX, intf - ns->intfs, frame->dat);
+        memset(pkt, 0, sizeof(cdn_pkt_t));
+        pkt->frm = frame;
+        pkt->_l_net = intf->net;
+
+        int ret = cdn_frame_r(pkt);
+        if (!ret)
+            cd_trace_pt(CD_TRACE_POLL, pkt->dst.port, frame);
+#ifdef CDN_FORWARD
+        if (!ret && cdn_forward(ns, intf, pkt))
+            continue; // keep rx_tmp for next frame
+#endif
+#ifdef CDN_MCAST_MAX
+        if (!ret && pkt->dst.addr[0] == 0xf0) {
+            cdn_mcast_rx(ns, intf, pkt);
+            ns->rx_tmp = NULL;
+            continue;
+        }
+#endif
+        if (!ret) {
+            cdn_sock_t *sock = cdn_sock_search(ns, pkt->dst.port);
+            if (!ret && sock && !sock->tx_only) {
+                cdn_sock_rx(ns, sock, pkt);
             } else {
-                d_verbose("cdn rx: frame err: %d\n", ret);
+                d_verbose("cdn rx: no sock\n");
                 cdn_pkt_free(ns, pkt);
             }
-            ns->rx_tmp = NULL;
+        } else {
+            d_verbose("cdn rx: frame err: %d\n", ret);
+            cdn_rx_err_cnt(intf, ret);
+            cdn_pkt_free(ns, pkt);
+        }
+        ns->rx_tmp = NULL;
+    }
+    return cnt;
+}
+
+// round-robin between interfaces, return true if budget exhausted with rx pending
+bool cdn_poll(cdn_ns_t *ns)
+{
+    int budget = CDN_POLL_BUDGET;
+    bool pending = true;
+
+    while (pending) {
+        pending = false;
+        for (int n = 0; n < CDN_INTF_MAX; n++) {
+            cdn_intf_t *intf = &ns->intfs[ns->poll_idx];
+            ns->poll_idx = (ns->poll_idx + 1) % CDN_INTF_MAX;
+            if (!intf->dev)
+                continue;
+
+            int quota = min(CDN_POLL_INTF_BUDGET, budget);
+            int cnt = cdn_poll_intf(ns, intf, quota);
+            budget -= cnt;
+            if (cnt == quota)
+                pending = true;
+            if (!budget)
+                return pending;
         }
     }
+    return false;
 }
 
 
+static inline void cdn_frm_set_prio(cdn_pkt_t *pkt)
+{
+#ifdef CD_TX_PRIO_NUM
+    pkt->frm->prio = (pkt->conf & CDN_CONF_PRIO_MSK) >> 4;
+#else
+    (void)pkt;
+#endif
+}
+
 int cdn_send_frame(cdn_ns_t *ns, cdn_pkt_t *pkt)
 {
     int ret;
@@ -98,6 +484,9 @@ int cdn_send_frame(cdn_ns_t *ns, cdn_pkt_t *pkt)
     ret = cdn_frame_w(pkt);
     if (ret)
         return CDN_RET_FMT_ERR;
+    cdn_frm_set_prio(pkt);
+    cd_cap_frame(CD_CAP_TX, intf - ns->intfs, pkt->frm->dat);
+    cd_trace_pt(CD_TRACE_TX_Q, pkt->src.port, pkt->frm);
     intf->dev->send_frame(intf->dev, pkt->frm);
     pkt->frm = NULL;
     pkt->dat = NULL;
@@ -111,7 +500,7 @@ int cdn_send_pkt(cdn_ns_t *ns, cdn_pkt_t *pkt)
         cdn_sock_t *sock = cdn_sock_search(ns, pkt->dst.port);
         if (sock && !sock->tx_only) {
             memcpy(pkt->src.addr, pkt->dst.addr, 3);
-            cdn_list_put(&sock->rx_head, pkt);
+            cdn_sock_rx(ns, sock, pkt);
         } else {
             d_verbose("tx: localhost no sock\n");
             cdn_pkt_free(ns, pkt);
@@ -137,14 +526,185 @@ cdn_pkt_t *cdn_sock_recvfrom(cdn_sock_t *sock)
 {
     if (!sock->rx_head.len)
         return NULL;
-    return cdn_list_get(&sock->rx_head);
+    if (sock->reserved)
+        sock->ns->rx_reserved++;
+    cdn_pkt_t *pkt = cdn_list_get(&sock->rx_head);
+    if (pkt)
+        cd_trace_pt(CD_TRACE_RECV, sock->port, pkt->frm);
+    return pkt;
+}
+
+// send all pkts in the chain (pkts become empty), route once for consecutive pkts to the same dst,
+// return the number of pkts failed
+int cdn_sock_sendto_batch(cdn_sock_t *sock, list_head_t *pkts)
+{
+    cdn_ns_t *ns = sock->ns;
+    list_head_t frms[CDN_INTF_MAX] = { 0 };
+    cdn_intf_t *intf = NULL;
+    cdn_sockaddr_t last_dst = { 0 }, last_src = { 0 }; // route result for last dst
+    uint8_t last_s_mac = 0, last_d_mac = 0;
+    int err_cnt = 0;
+    cdn_pkt_t *pkt;
+
+    while ((pkt = list_get_entry(pkts, cdn_pkt_t)) != NULL) {
+        pkt->src.port = sock->port;
+        if (pkt->dst.addr[0] == 0x10) { // localhost
+            cdn_send_pkt(ns, pkt);
+            continue;
+        }
+
+        if (intf && !memcmp(pkt->dst.addr, last_dst.addr, 3)) {
+            memcpy(pkt->src.addr, last_src.addr, 3);
+            pkt->_s_mac = last_s_mac;
+            pkt->_d_mac = last_d_mac;
+        } else {
+            intf = cdn_route(ns, pkt);
+            memcpy(last_dst.addr, pkt->dst.addr, 3);
+            memcpy(last_src.addr, pkt->src.addr, 3);
+            last_s_mac = pkt->_s_mac;
+            last_d_mac = pkt->_d_mac;
+        }
+
+        int ret = !intf ? CDN_RET_ROUTE_ERR : (cdn_frame_w(pkt) ? CDN_RET_FMT_ERR : 0);
+        if (!ret) {
+            cdn_frm_set_prio(pkt);
+            cd_cap_frame(CD_CAP_TX, intf - ns->intfs, pkt->frm->dat);
+            cd_trace_pt(CD_TRACE_TX_Q, pkt->src.port, pkt->frm);
+            cd_list_put(&frms[intf - ns->intfs], pkt->frm);
+            pkt->frm = NULL;
+            pkt->dat = NULL;
+        } else {
+            d_verbose("tx batch: err: %d\n", ret);
+            err_cnt++;
+        }
+        pkt->ret = 0x80 | ret;
+        if (!(pkt->conf & CDN_CONF_NOT_FREE))
+            cdn_pkt_free(ns, pkt);
+    }
+
+    for (int i = 0; i < CDN_INTF_MAX; i++) {
+        cd_dev_t *dev = ns->intfs[i].dev;
+        if (!frms[i].len)
+            continue;
+        if (dev->send_frames) {
+            dev->send_frames(dev, &frms[i]);
+        } else {
+            cd_frame_t *frm;
+            while ((frm = list_get_entry(&frms[i], cd_frame_t)) != NULL)
+                dev->send_frame(dev, frm);
+        }
+    }
+    return err_cnt;
+}
+
+// move up to max pkts to the end of the out chain, return the count
+int cdn_sock_recvfrom_batch(cdn_sock_t *sock, list_head_t *out, int max)
+{
+    if (!sock->rx_head.len)
+        return 0;
+#ifdef CD_TRACE
+    list_node_t *pre = out->last;
+#endif
+    int cnt = cdn_list_get_list(&sock->rx_head, out, max);
+#ifdef CD_TRACE
+    if (cd_trace) {
+        for (list_node_t *pos = pre ? pre->next : out->first; pos; pos = pos->next)
+            cd_trace_pt(CD_TRACE_RECV, sock->port, list_entry(pos, cdn_pkt_t)->frm);
+    }
+#endif
+    if (sock->reserved)
+        sock->ns->rx_reserved += cnt;
+    return cnt;
 }
 
 int cdn_sock_bind(cdn_sock_t *sock)
 {
-    return cdn_sock_insert(sock);
+    int ret = cdn_sock_insert(sock);
+    if (!ret && sock->rx_policy == CDN_RX_RESERVE) {
+        sock->ns->rx_reserved += sock->rx_max - min(sock->rx_head.len, sock->rx_max);
+        sock->reserved = true;
+    }
+    return ret;
 }
 
+int cdn_sock_unbind(cdn_sock_t *sock)
+{
+    int ret = cdn_sock_remove(sock);
+    if (!ret && sock->reserved) {
+        sock->ns->rx_reserved -= sock->rx_max - min(sock->rx_head.len, sock->rx_max);
+        sock->reserved = false;
+    }
+    return ret;
+}
+
+#ifdef CDN_MCAST_MAX
+
+int cdn_mcast_join(cdn_ns_t *ns, uint16_t group, cdn_sock_t *sock)
+{
+    cdn_mcast_t *empty = NULL;
+    for (int i = 0; i < CDN_MCAST_MAX; i++) {
+        cdn_mcast_t *m = &ns->mcast[i];
+        if (m->sock == sock && m->group == group)
+            return 0;
+#ifdef CDN_FORWARD
+        if (!m->sock && !m->intf && !empty)
+#else
+        if (!m->sock && !empty)
+#endif
+            empty = m;
+    }
+    if (!empty)
+        return -1;
+    empty->group = group;
+    empty->sock = sock;
+    return 0;
+}
+
+int cdn_mcast_leave(cdn_ns_t *ns, uint16_t group, cdn_sock_t *sock)
+{
+    for (int i = 0; i < CDN_MCAST_MAX; i++) {
+        cdn_mcast_t *m = &ns->mcast[i];
+        if (m->sock == sock && m->group == group) {
+            m->sock = NULL;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+#ifdef CDN_FORWARD
+int cdn_mcast_join_intf(cdn_ns_t *ns, uint16_t group, cdn_intf_t *intf)
+{
+    cdn_mcast_t *empty = NULL;
+    for (int i = 0; i < CDN_MCAST_MAX; i++) {
+        cdn_mcast_t *m = &ns->mcast[i];
+        if (m->intf && m->group == group)
+            return m->intf == intf ? 0 : -1;
+        if (!m->sock && !m->intf && !empty)
+            empty = m;
+    }
+    if (!empty)
+        return -1;
+    empty->group = group;
+    empty->intf = intf;
+    return 0;
+}
+
+int cdn_mcast_leave_intf(cdn_ns_t *ns, uint16_t group, cdn_intf_t *intf)
+{
+    for (int i = 0; i < CDN_MCAST_MAX; i++) {
+        cdn_mcast_t *m = &ns->mcast[i];
+        if (m->intf == intf && m->group == group) {
+            m->intf = NULL;
+            return 0;
+        }
+    }
+    return -1;
+}
+#endif
+
+#endif
+
 int cdn_add_intf(cdn_ns_t *ns, cd_dev_t *dev, uint8_t net, uint8_t mac)
 {
     for (int i = 0; i < CDN_INTF_MAX; i++) {
@@ -152,6 +712,9 @@ int cdn_add_intf(cdn_ns_t *ns, cd_dev_t *dev, uint8_t net, uint8_t mac)
             ns->intfs[i].dev = dev;
             ns->intfs[i].net = net;
             ns->intfs[i].mac = mac;
+#ifdef CDN_ROUTE_MAX
+            cdn_route_flush_cache(ns);
+#endif
             return 0;
         }
     }
@@ -21,14 +21,67 @@ extern "C" {
 #define CDN_INTF_MAX            1
 #endif
 
+// rx frames limit for each cdn_poll call, and for each intf in one round-robin turn
+#ifndef CDN_POLL_BUDGET
+#define CDN_POLL_BUDGET         64
+#endif
+#ifndef CDN_POLL_INTF_BUDGET
+#define CDN_POLL_INTF_BUDGET    16
+#endif
+
+// index bound sockets by port in an open-addressing table (for large port counts),
+// size: 1 << CDN_SOCK_TBL_BITS, must be larger than the number of bound sockets
+//#define CDN_SOCK_TBL_BITS       10
+
+// built-in routing table for multiple interfaces and unique local (0xa0) destinations
+//#define CDN_ROUTE_MAX           8
+#if defined(CDN_ROUTE_MAX) && !defined(CDN_ROUTE_CACHE_SIZE)
+#define CDN_ROUTE_CACHE_SIZE    16      // power of 2, direct-mapped by dst.addr
+#endif
+
+// gateway mode: forward unique local frames for other nets without copy, require CDN_ROUTE_MAX
+//#define CDN_FORWARD
+#if defined(CDN_FORWARD) && !defined(CDN_ROUTE_MAX)
+#error "CDN_FORWARD requires CDN_ROUTE_MAX"
+#endif
+
+// multicast group membership table, deliver one rx frame to all members without copy
+//#define CDN_MCAST_MAX           8
+#if defined(CDN_MCAST_MAX) && !defined(CD_FRAME_REF)
+#error "CDN_MCAST_MAX requires CD_FRAME_REF"
+#endif
+
+// embed the pkt descriptor with its frame (cdn_slab_t), so alloc / free / rx take one list operation,
+// free_frm holds the frames of slabs and free_pkt is not used.
+// the pkt belongs to the frame: after a successful send, the pkt is released with the frame,
+// so pkt->ret of CDN_CONF_NOT_FREE is only valid on error
+//#define CDN_PKT_IN_FRM
+#if defined(CDN_PKT_IN_FRM) && (defined(CD_FRAME_REF) || defined(CD_FRAME_CLASS_SIZES))
+#error "CDN_PKT_IN_FRM conflicts with CD_FRAME_REF and CD_FRAME_CLASS_SIZES"
+#endif
+
 struct _cdn_ns;
 
-typedef struct {
+typedef enum {
+    CDN_RX_DROP_NEW = 0,        // drop incoming pkt if rx_head is full
+    CDN_RX_DROP_OLD,            // drop the oldest pkt in rx_head
+    CDN_RX_RESERVE              // keep rx_max pkts in the shared pool for this sock
+} cdn_rx_policy_t;
+
+typedef struct cdn_sock {
     list_node_t     node;
     struct _cdn_ns  *ns;        // cdn_ns_t
     uint16_t        port;
     list_head_t     rx_head;
     bool            tx_only;
+
+    // optional, called from cdn_poll instead of queuing to rx_head, take over the pkt
+    void            (*rx_cb)(struct cdn_sock *sock, cdn_pkt_t *pkt);
+
+    uint16_t        rx_max;     // rx_head depth limit, 0: unlimited (except CDN_RX_RESERVE)
+    uint8_t         rx_policy;  // cdn_rx_policy_t
+    bool            reserved;   // CDN_RX_RESERVE: counted in ns->rx_reserved, set by bind
+    uint32_t        rx_drop_cnt;
 } cdn_sock_t;
 
 typedef struct {
@@ -37,14 +90,71 @@ typedef struct {
     // interface address
     uint8_t         net;
     uint8_t         mac;
+
+    uint32_t        rx_hdr_err;     // rx frames dropped by cdn_frame_r: CDN_FRM_ERR_HDR
+    uint32_t        rx_len_err;     // CDN_FRM_ERR_LEN
+    uint32_t        rx_size_err;    // CDN_FRM_ERR_SIZE
+
+#ifdef CDN_FORWARD
+    uint32_t        fwd_cnt;        // rx frames forwarded to other intf
+    uint32_t        fwd_drop_cnt;   // rx frames for other nets without route
+#endif
 } cdn_intf_t;
 
+#ifdef CDN_ROUTE_MAX
+typedef struct {
+    cdn_intf_t      *intf;      // NULL: unused
+    uint8_t         net;        // dst net
+    uint8_t         mac;        // next-hop mac
+} cdn_route_t;
+
+typedef struct {
+    cdn_intf_t      *intf;      // NULL: invalid
+    uint8_t         addr[3];    // dst.addr
+    uint8_t         mac;        // _d_mac
+} cdn_route_cache_t;
+#endif
+
+#ifdef CDN_MCAST_MAX
+typedef struct {
+    uint16_t        group;      // [mh, ml]: dst.addr[1] << 8 | dst.addr[2]
+    cdn_sock_t      *sock;      // member, not required to be bound, matched by port
+#ifdef CDN_FORWARD
+    cdn_intf_t      *intf;      // or egress intf (one per group)
+#endif
+} cdn_mcast_t;
+#endif
+
+#ifdef CDN_PKT_IN_FRM
+typedef struct {
+    cdn_pkt_t       pkt;
+    cd_frame_t      frm;
+} cdn_slab_t;
+
+#define cdn_frm_pkt(frame)  (&container_of(frame, cdn_slab_t, frm)->pkt)
+#endif
+
 typedef struct _cdn_ns {
-    list_head_t     *free_pkt;
+    list_head_t     *free_pkt;  // NULL for CDN_PKT_IN_FRM
     list_head_t     *free_frm;
+#ifdef CDN_SOCK_TBL_BITS
+    cdn_sock_t      *sock_tbl[1 << CDN_SOCK_TBL_BITS];
+    uint32_t        sock_cnt;
+#else
     list_head_t     socks;
+#endif
     cdn_intf_t      intfs[CDN_INTF_MAX];
     cdn_pkt_t       *rx_tmp;
+    uint8_t         poll_idx;   // next intf to poll
+    uint32_t        rx_reserved; // free pkts kept for CDN_RX_RESERVE socks, from cdn_pkt_alloc and other socks rx
+#ifdef CDN_ROUTE_MAX
+    cdn_route_t     routes[CDN_ROUTE_MAX];
+    cdn_route_t     route_dft;  // default route for unique local
+    cdn_route_cache_t route_cache[CDN_ROUTE_CACHE_SIZE];
+#endif
+#ifdef CDN_MCAST_MAX
+    cdn_mcast_t     mcast[CDN_MCAST_MAX];
+#endif
 } cdn_ns_t; // name space
 
 
@@ -53,13 +163,32 @@ int cdn_send_frame(cdn_ns_t *ns, cdn_pkt_t *pkt);
 int cdn_send_pkt(cdn_ns_t *ns, cdn_pkt_t *pkt);
 
 int cdn_sock_bind(cdn_sock_t *sock);
+int cdn_sock_unbind(cdn_sock_t *sock);
 int cdn_sock_sendto(cdn_sock_t *sock, cdn_pkt_t *pkt);
 cdn_pkt_t *cdn_sock_recvfrom(cdn_sock_t *sock);
+int cdn_sock_sendto_batch(cdn_sock_t *sock, list_head_t *pkts);
+int cdn_sock_recvfrom_batch(cdn_sock_t *sock, list_head_t *out, int max);
 
-void cdn_poll(cdn_ns_t *ns);
+bool cdn_poll(cdn_ns_t *ns); // return true if more rx pending
 void cdn_init_ns(cdn_ns_t *ns, list_head_t *free_pkt, list_head_t *free_frm);
 int cdn_add_intf(cdn_ns_t *ns, cd_dev_t *dev, uint8_t net, uint8_t mac);
 
+#ifdef CDN_ROUTE_MAX
+int cdn_route_add(cdn_ns_t *ns, uint8_t net, cdn_intf_t *intf, uint8_t mac);
+int cdn_route_del(cdn_ns_t *ns, uint8_t net);
+void cdn_route_set_dft(cdn_ns_t *ns, cdn_intf_t *intf, uint8_t mac); // intf NULL: remove
+void cdn_route_flush_cache(cdn_ns_t *ns);
+#endif
+
+#ifdef CDN_MCAST_MAX
+int cdn_mcast_join(cdn_ns_t *ns, uint16_t group, cdn_sock_t *sock);
+int cdn_mcast_leave(cdn_ns_t *ns, uint16_t group, cdn_sock_t *sock);
+#ifdef CDN_FORWARD
+int cdn_mcast_join_intf(cdn_ns_t *ns, uint16_t group, cdn_intf_t *intf);
+int cdn_mcast_leave_intf(cdn_ns_t *ns, uint16_t group, cdn_intf_t *intf);
+#endif
+#endif
+
 
 static inline void cdn_pkt_prepare(cdn_sock_t *sock, cdn_pkt_t *pkt)
 {
@@ -72,7 +201,43 @@ static inline void cdn_pkt_prepare(cdn_sock_t *sock, cdn_pkt_t *pkt)
     }
 }
 
-static inline cdn_pkt_t *cdn_pkt_alloc(cdn_ns_t *ns)
+#ifdef CDN_PKT_IN_FRM
+
+static inline uint32_t cdn_pkt_free_len(const cdn_ns_t *ns)
+{
+    return ns->free_frm->len;
+}
+
+// ignore ns->rx_reserved, e.g. for the owner of a CDN_RX_RESERVE sock
+static inline cdn_pkt_t *_cdn_pkt_alloc(cdn_ns_t *ns)
+{
+    cd_frame_t *frame = cd_list_get(ns->free_frm);
+    if (!frame)
+        return NULL;
+    cdn_pkt_t *pkt = cdn_frm_pkt(frame);
+    memset(pkt, 0, sizeof(cdn_pkt_t));
+    pkt->frm = frame;
+    return pkt;
+}
+
+// pkt->frm is NULL if the frame has been passed to a device
+static inline void cdn_pkt_free(cdn_ns_t *ns, cdn_pkt_t *pkt)
+{
+    if (pkt->frm) {
+        cd_list_put(ns->free_frm, pkt->frm);
+        pkt->frm = NULL;
+    }
+}
+
+#else
+
+static inline uint32_t cdn_pkt_free_len(const cdn_ns_t *ns)
+{
+    return min(ns->free_pkt->len, ns->free_frm->len);
+}
+
+// ignore ns->rx_reserved, e.g. for the owner of a CDN_RX_RESERVE sock
+static inline cdn_pkt_t *_cdn_pkt_alloc(cdn_ns_t *ns)
 {
     cd_frame_t *frame = cd_list_get(ns->free_frm);
     if (!frame)
@@ -90,12 +255,54 @@ static inline cdn_pkt_t *cdn_pkt_alloc(cdn_ns_t *ns)
 static inline void cdn_pkt_free(cdn_ns_t *ns, cdn_pkt_t *pkt)
 {
     if (pkt->frm) {
-        cd_list_put(ns->free_frm, pkt->frm);
+        cd_frame_free(ns->free_frm, pkt->frm);
         pkt->frm = NULL;
     }
     cdn_list_put(ns->free_pkt, pkt);
 }
 
+#endif
+
+// keep ns->rx_reserved free pkts for the CDN_RX_RESERVE socks
+static inline cdn_pkt_t *cdn_pkt_alloc(cdn_ns_t *ns)
+{
+    if (cdn_pkt_free_len(ns) <= ns->rx_reserved)
+        return NULL;
+    return _cdn_pkt_alloc(ns);
+}
+
+#ifdef CD_FRAME_CLASS_SIZES
+// after cdn_pkt_prepare, move a reused pkt to a larger frame class if len bytes of payload not fit,
+// the payload is not copied
+static inline int cdn_pkt_fit(cdn_ns_t *ns, cdn_pkt_t *pkt, unsigned len)
+{
+    unsigned ofs = pkt->dat - pkt->frm->dat;
+    if (ofs + len + 2 <= cd_frame_size(pkt->frm)) // room for uart crc
+        return 0;
+    cd_frame_t *frm = cd_frame_get_fit(ns->free_frm, ofs + len + 2);
+    if (!frm)
+        return -1;
+    cd_frame_free(ns->free_frm, pkt->frm);
+    pkt->frm = frm;
+    pkt->dat = frm->dat + ofs;
+    return 0;
+}
+#endif
+
+#ifdef CD_FRAME_REF
+// new pkt sharing the frame of pkt, e.g. for multiple rx queues
+static inline cdn_pkt_t *cdn_pkt_clone(cdn_ns_t *ns, const cdn_pkt_t *pkt)
+{
+    cdn_pkt_t *n = cdn_list_get(ns->free_pkt);
+    if (!n)
+        return NULL;
+    *n = *pkt;
+    if (n->frm)
+        cd_frame_ref(ns->free_frm, n->frm);
+    return n;
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
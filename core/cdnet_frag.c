@@ -0,0 +1,174 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cdnet_frag.h"
+#include "cd_debug.h"
+
+
+// all fragments are allocated before sending, return -1 if not enough free pkts
+int cdn_frag_sendto(cdn_sock_t *sock, const cdn_sockaddr_t *dst, const uint8_t *dat, unsigned len, uint8_t id)
+{
+    cdn_ns_t *ns = sock->ns;
+    list_head_t pkts = { 0 };
+    unsigned ofs = 0;
+    unsigned idx = 0;
+
+    do {
+        cdn_pkt_t *pkt = idx < CDN_FRAG_MAX ? cdn_pkt_alloc(ns) : NULL;
+        if (!pkt)
+            goto err;
+        list_put(&pkts, &pkt->node);
+        pkt->dst = *dst;
+        cdn_pkt_prepare(sock, pkt);
+
+        // room for uart crc
+        unsigned chunk = CD_FRAME_SIZE - 2 - (pkt->dat - pkt->frm->dat) - CDN_FRAG_HDR_SIZE;
+        chunk = min(chunk, len - ofs);
+        pkt->dat[0] = id;
+        pkt->dat[1] = idx++;
+        put_unaligned16(ofs, pkt->dat + 3);
+        memcpy(pkt->dat + CDN_FRAG_HDR_SIZE, dat + ofs, chunk);
+        pkt->len = CDN_FRAG_HDR_SIZE + chunk;
+        ofs += chunk;
+    } while (ofs < len);
+
+    list_node_t *pos;
+    list_for_each_ro(&pkts, pos)
+        list_entry(pos, cdn_pkt_t)->dat[2] = idx;
+    return cdn_sock_sendto_batch(sock, &pkts) ? -1 : 0;
+
+err:
+    d_verbose("frag: no free pkt or too long\n");
+    cdn_pkt_t *pkt;
+    while ((pkt = list_get_entry(&pkts, cdn_pkt_t)) != NULL)
+        cdn_pkt_free(ns, pkt);
+    return -1;
+}
+
+
+static inline void cdn_frag_ent_put(cdn_frag_ent_t *ent)
+{
+    ent->busy = false;
+    cd_timer_del(&ent->tm);
+}
+
+// release an incomplete message
+static void cdn_frag_ent_timeout(cd_timer_t *tm)
+{
+    cdn_frag_ent_t *ent = container_of(tm, cdn_frag_ent_t, tm);
+    d_debug("frag: msg %d timeout, %d/%d\n", ent->id, ent->rcv_cnt, ent->cnt);
+    ent->busy = false;
+    ent->rx->timeout_cnt++;
+}
+
+static cdn_frag_ent_t *cdn_frag_ent_get(cdn_frag_rx_t *rx, const cdn_pkt_t *pkt)
+{
+    cdn_frag_ent_t *empty = NULL;
+
+    for (int i = 0; i < rx->ent_num; i++) {
+        cdn_frag_ent_t *ent = &rx->ents[i];
+        if (!ent->busy) {
+            if (!empty)
+                empty = ent;
+            continue;
+        }
+        if (ent->src.port != pkt->src.port || memcmp(ent->src.addr, pkt->src.addr, 3))
+            continue;
+        if (ent->id == pkt->dat[0])
+            return ent;
+        // the sender has moved on to a new message
+        d_debug("frag: abandon msg %d\n", ent->id);
+        rx->drop_cnt++;
+        empty = ent;
+        break;
+    }
+
+    if (empty) {
+        memset(empty->map, 0, sizeof(empty->map));
+        empty->busy = true;
+        empty->src = pkt->src;
+        empty->id = pkt->dat[0];
+        empty->cnt = pkt->dat[2];
+        empty->rcv_cnt = 0;
+        empty->len = 0;
+    }
+    return empty;
+}
+
+static void cdn_frag_rx_cb(cdn_sock_t *sock, cdn_pkt_t *pkt)
+{
+    cdn_frag_rx_t *rx = container_of(sock, cdn_frag_rx_t, sock);
+    if (pkt->len < CDN_FRAG_HDR_SIZE) {
+        d_verbose("frag: fmt err\n");
+        goto drop;
+    }
+
+    uint8_t idx = pkt->dat[1];
+    uint8_t cnt = pkt->dat[2];
+    unsigned ofs = get_unaligned16(pkt->dat + 3);
+    unsigned len = pkt->len - CDN_FRAG_HDR_SIZE;
+    if (!cnt || idx >= cnt || cnt > CDN_FRAG_MAX) {
+        d_verbose("frag: fmt err\n");
+        goto drop;
+    }
+
+    cdn_frag_ent_t *ent = cdn_frag_ent_get(rx, pkt);
+    if (!ent) {
+        d_verbose("frag: no free entry\n");
+        goto drop;
+    }
+    if (cnt != ent->cnt || ofs + len > ent->size) {
+        d_debug("frag: msg %d, err: cnt %d, ofs %d\n", ent->id, cnt, ofs);
+        cdn_frag_ent_put(ent);
+        goto drop;
+    }
+
+    cd_timer_mod(rx->wheel, &ent->tm, rx->timeout);
+    uint32_t bit = 1u << (idx & 31);
+    if (!(ent->map[idx / 32] & bit)) {
+        ent->map[idx / 32] |= bit;
+        ent->rcv_cnt++;
+        memcpy(ent->buf + ofs, pkt->dat + CDN_FRAG_HDR_SIZE, len);
+        if (idx == cnt - 1)
+            ent->len = ofs + len;
+    }
+    cdn_pkt_free(sock->ns, pkt);
+
+    if (ent->rcv_cnt == ent->cnt) {
+        rx->cb(rx, ent);
+        cdn_frag_ent_put(ent);
+    }
+    return;
+
+drop:
+    rx->drop_cnt++;
+    cdn_pkt_free(sock->ns, pkt);
+}
+
+
+// set ents, ent_num, cb before init, port: CDN_FRAG_PORT_BASE ~ +15
+int cdn_frag_rx_init(cdn_frag_rx_t *rx, cdn_ns_t *ns, cd_timer_wheel_t *wheel, uint16_t port)
+{
+    cdn_assert(port >= CDN_FRAG_PORT_BASE && port < CDN_FRAG_PORT_BASE + 16);
+    rx->wheel = wheel;
+    if (!rx->timeout)
+        rx->timeout = 200000 / CD_SYSTICK_US_DIV; // 200 ms
+    for (int i = 0; i < rx->ent_num; i++) {
+        cdn_frag_ent_t *ent = &rx->ents[i];
+        ent->busy = false;
+        ent->rx = rx;
+        ent->tm.pprev = NULL;
+        ent->tm.cb = cdn_frag_ent_timeout;
+    }
+    memset(&rx->sock, 0, sizeof(cdn_sock_t));
+    rx->sock.ns = ns;
+    rx->sock.port = port;
+    rx->sock.rx_cb = cdn_frag_rx_cb;
+    return cdn_sock_bind(&rx->sock);
+}
@@ -0,0 +1,79 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CDNET_FRAG_H__
+#define __CDNET_FRAG_H__
+
+#include "cdnet_core.h"
+#include "cd_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fragmentation for messages larger than one frame (best effort, no retransmission)
+//
+// Receiver ports: CDN_FRAG_PORT_BASE ~ +15
+// Fragment: [id, idx, cnt, ofs_l, ofs_h] + data
+//   id: message id chosen by the sender, idx: 0 ~ cnt-1, ofs: data offset in the message
+// Fragments may arrive out of order, the message length is known from the last fragment.
+// Data is copied from the rx frames straight into the buffer of a reassembly entry.
+// Incomplete messages expire by the timer wheel, call cd_timer_run() in the main loop.
+
+#ifndef CDN_FRAG_PORT_BASE
+#define CDN_FRAG_PORT_BASE      0x30
+#endif
+#ifndef CDN_FRAG_MAX
+#define CDN_FRAG_MAX            64      // max fragments per message, multiple of 32
+#endif
+
+#define CDN_FRAG_HDR_SIZE       5
+
+struct cdn_frag_rx;
+
+typedef struct {
+    uint8_t         *buf;       // set by user
+    uint16_t        size;
+
+    bool            busy;
+    cdn_sockaddr_t  src;
+    uint8_t         id;
+    uint8_t         cnt;
+    uint8_t         rcv_cnt;
+    uint16_t        len;        // message length, valid after the last fragment
+    uint32_t        map[CDN_FRAG_MAX / 32]; // received fragments
+    cd_timer_t      tm;         // timeout since the last fragment
+    struct cdn_frag_rx *rx;
+} cdn_frag_ent_t;
+
+typedef struct cdn_frag_rx {
+    cdn_sock_t      sock;       // port: CDN_FRAG_PORT_BASE ~ +15
+    cd_timer_wheel_t *wheel;
+    cdn_frag_ent_t  *ents;      // bounded reassembly table
+    uint8_t         ent_num;
+    uint32_t        timeout;    // unit: systick
+
+    // complete message: ent->buf, ent->len, the entry is released after return
+    void            (*cb)(struct cdn_frag_rx *rx, cdn_frag_ent_t *ent);
+    void            *arg;
+
+    uint32_t        drop_cnt;   // statistics
+    uint32_t        timeout_cnt;
+} cdn_frag_rx_t;
+
+
+int cdn_frag_sendto(cdn_sock_t *sock, const cdn_sockaddr_t *dst, const uint8_t *dat, unsigned len, uint8_t id);
+
+int cdn_frag_rx_init(cdn_frag_rx_t *rx, cdn_ns_t *ns, cd_timer_wheel_t *wheel, uint16_t port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
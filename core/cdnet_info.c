@@ -0,0 +1,100 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cdnet_info.h"
+#include "cd_debug.h"
+#include <stdlib.h>
+
+
+static bool cdn_info_contains(const char *s, const uint8_t *sub, int len)
+{
+    int s_len = strlen(s);
+    for (int i = 0; i + len <= s_len; i++) {
+        if (!memcmp(s + i, sub, len))
+            return true;
+    }
+    return false;
+}
+
+static uint8_t cdn_info_local_mac(cdn_ns_t *ns, const cdn_pkt_t *pkt)
+{
+    for (int i = 0; i < CDN_INTF_MAX; i++) {
+        if (ns->intfs[i].dev && ns->intfs[i].net == pkt->_l_net)
+            return ns->intfs[i].mac;
+    }
+    return ns->intfs[0].mac;
+}
+
+static void cdn_info_reply(cdn_info_t *inf, cdn_pkt_t *pkt)
+{
+    pkt->dst = pkt->src;
+    cdn_pkt_prepare(&inf->sock, pkt);
+#ifdef CD_FRAME_CLASS_SIZES
+    cdn_pkt_fit(inf->sock.ns, pkt, strlen(inf->info)); // truncate below if failed
+#endif
+    pkt->len = min((int)strlen(inf->info), cd_frame_size(pkt->frm) - 2 - (pkt->dat - pkt->frm->dat)); // room for uart crc
+    memcpy(pkt->dat, inf->info, pkt->len);
+    cdn_sock_sendto(&inf->sock, pkt);
+}
+
+// send the delayed search reply
+static void cdn_info_timeout(cd_timer_t *tm)
+{
+    cdn_info_t *inf = container_of(tm, cdn_info_t, tm);
+    cdn_pkt_t *pkt = inf->pending;
+    inf->pending = NULL;
+    cdn_info_reply(inf, pkt);
+}
+
+static void cdn_info_rx_cb(cdn_sock_t *sock, cdn_pkt_t *pkt)
+{
+    cdn_info_t *inf = container_of(sock, cdn_info_t, sock);
+    cdn_ns_t *ns = sock->ns;
+
+    if (pkt->len == 0) {
+        cdn_info_reply(inf, pkt);
+        return;
+    }
+
+    // [0x10, max_time, mac_start, mac_end, "string"]
+    if (pkt->dat[0] == 0x10 && pkt->len >= 5) {
+        uint16_t max_time = get_unaligned16(pkt->dat + 1);
+        uint8_t mac = cdn_info_local_mac(ns, pkt);
+
+        if (mac >= pkt->dat[3] && mac <= pkt->dat[4] &&
+                cdn_info_contains(inf->info, pkt->dat + 5, pkt->len - 5)) {
+            inf->locked = false;
+            if (inf->pending)
+                cdn_pkt_free(ns, inf->pending);
+            inf->pending = pkt;
+            uint32_t delay = max_time ? CDN_INFO_RAND() % (max_time + 1) : 0;
+            cd_timer_add(inf->wheel, &inf->tm, get_systick() + delay * 1000 / CD_SYSTICK_US_DIV);
+            d_verbose("info: search match, delay %"PRIu32" ms\n", delay);
+        } else {
+            inf->locked = true;
+            d_verbose("info: search not match, locked\n");
+            cdn_pkt_free(ns, pkt);
+        }
+        return;
+    }
+
+    cdn_pkt_free(ns, pkt);
+}
+
+int cdn_info_init(cdn_info_t *inf, cdn_ns_t *ns, cd_timer_wheel_t *wheel, const char *info)
+{
+    memset(inf, 0, sizeof(cdn_info_t));
+    inf->info = info;
+    inf->wheel = wheel;
+    inf->tm.cb = cdn_info_timeout;
+    inf->sock.ns = ns;
+    inf->sock.port = 1;
+    inf->sock.rx_cb = cdn_info_rx_cb;
+    return cdn_sock_bind(&inf->sock);
+}
@@ -0,0 +1,46 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CDNET_INFO_H__
+#define __CDNET_INFO_H__
+
+#include "cdnet_core.h"
+#include "cd_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Port 01 service: read device_info, search devices by filters (see Readme)
+// The delayed search reply is sent by the timer wheel, call cd_timer_run() in the main loop.
+
+#ifndef CDN_INFO_RAND
+#define CDN_INFO_RAND()     rand()
+#endif
+
+typedef struct {
+    cdn_sock_t      sock;       // port 1
+    const char      *info;      // device_info, e.g. "M: model; S: serial id; ..."
+
+    // set after a search without match, the user should reject modify-mac / save-config commands
+    bool            locked;
+
+    cdn_pkt_t       *pending;   // search reply waiting for the random delay
+    cd_timer_t      tm;
+    cd_timer_wheel_t *wheel;
+} cdn_info_t;
+
+
+int cdn_info_init(cdn_info_t *inf, cdn_ns_t *ns, cd_timer_wheel_t *wheel, const char *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cdnet_rpc.h"
+#include "cd_debug.h"
+
+#define CDN_RPC_WORDS(rpc)  (((rpc)->port_num + 31u) / 32)
+
+
+static int cdn_rpc_port_get(cdn_rpc_t *rpc)
+{
+    unsigned words = CDN_RPC_WORDS(rpc);
+    unsigned w = rpc->port_next / 32;
+    uint32_t mask = ~0u << (rpc->port_next & 31);
+
+    // one more round for the bits before port_next in the first word
+    for (unsigned n = 0; n <= words; n++) {
+        uint32_t free = ~rpc->port_map[w] & mask;
+        if (free) {
+            unsigned i = w * 32 + __builtin_ctz(free);
+            rpc->port_map[w] |= 1u << (i & 31);
+            rpc->port_next = (i + 1) % rpc->port_num;
+            return i;
+        }
+        mask = ~0u;
+        w = (w + 1) % words;
+    }
+    return -1;
+}
+
+static inline void cdn_rpc_port_put(cdn_rpc_t *rpc, unsigned i)
+{
+    rpc->port_map[i / 32] &= ~(1u << (i & 31));
+}
+
+static void cdn_rpc_release(cdn_rpc_req_t *req)
+{
+    cdn_rpc_t *rpc = req->rpc;
+    unsigned i = req->sock.port - rpc->port_base;
+    cd_timer_del(&req->tm);
+    cdn_sock_unbind(&req->sock);
+    rpc->reqs[i] = NULL;
+    cdn_rpc_port_put(rpc, i);
+}
+
+// return -1 if no free pkt (req unchanged), or the ret of cdn_sock_sendto
+static int cdn_rpc_tx(cdn_rpc_req_t *req)
+{
+    cdn_pkt_t *pkt = cdn_pkt_alloc(req->rpc->ns);
+    if (!pkt)
+        return -1;
+    pkt->dst = req->dst;
+    cdn_pkt_prepare(&req->sock, pkt);
+    memcpy(pkt->dat, req->dat, req->len);
+    pkt->len = req->len;
+    return cdn_sock_sendto(&req->sock, pkt);
+}
+
+static void cdn_rpc_timeout(cd_timer_t *tm)
+{
+    cdn_rpc_req_t *req = container_of(tm, cdn_rpc_req_t, tm);
+    cdn_rpc_t *rpc = req->rpc;
+
+    if (req->retry) {
+        int ret = cdn_rpc_tx(req);
+        if (ret < 0) { // no free pkt, keep pending and try at the next tick
+            cd_timer_mod(rpc->wheel, tm, 0);
+            return;
+        }
+        req->retry--;
+        rpc->retry_cnt++;
+        d_verbose("rpc: retry port %x\n", req->sock.port);
+        if (!ret) {
+            cd_timer_mod(rpc->wheel, tm, req->timeout);
+            return;
+        }
+    }
+    rpc->timeout_cnt++;
+    cdn_rpc_release(req);
+    req->cb(req, NULL);
+}
+
+// the reply must come from the request dst, any node for multicast and broadcast requests
+static inline bool cdn_rpc_from_dst(const cdn_rpc_req_t *req, const cdn_pkt_t *pkt)
+{
+    if (pkt->src.port != req->dst.port)
+        return false;
+    if (req->dst.addr[0] == 0xf0 || req->dst.addr[2] == 0xff)
+        return true;
+    return !memcmp(pkt->src.addr, req->dst.addr, 3);
+}
+
+static void cdn_rpc_rx_cb(cdn_sock_t *sock, cdn_pkt_t *pkt)
+{
+    cdn_rpc_req_t *req = container_of(sock, cdn_rpc_req_t, sock);
+    cdn_ns_t *ns = sock->ns;
+    if (!cdn_rpc_from_dst(req, pkt)) {
+        d_verbose("rpc: port %x, drop reply from %02x:%02x:%02x:%x\n", sock->port,
+                pkt->src.addr[0], pkt->src.addr[1], pkt->src.addr[2], pkt->src.port);
+        req->rpc->mismatch_cnt++;
+        cdn_pkt_free(ns, pkt);
+        return;
+    }
+    cdn_rpc_release(req); // req can be sent again inside cb
+    req->cb(req, pkt);
+    cdn_pkt_free(ns, pkt);
+}
+
+
+int cdn_rpc_send(cdn_rpc_t *rpc, cdn_rpc_req_t *req)
+{
+    int i = cdn_rpc_port_get(rpc);
+    if (i < 0) {
+        d_verbose("rpc: no free port\n");
+        return -1;
+    }
+
+    memset(&req->sock, 0, sizeof(cdn_sock_t));
+    req->rpc = rpc;
+    req->sock.ns = rpc->ns;
+    req->sock.port = rpc->port_base + i;
+    req->sock.rx_cb = cdn_rpc_rx_cb;
+    req->tm.pprev = NULL;
+    req->tm.cb = cdn_rpc_timeout;
+    if (cdn_sock_bind(&req->sock)) {
+        cdn_rpc_port_put(rpc, i);
+        return -1;
+    }
+    rpc->reqs[i] = req;
+
+    if (cdn_rpc_tx(req)) {
+        cdn_rpc_release(req);
+        return -1;
+    }
+    cd_timer_mod(rpc->wheel, &req->tm, req->timeout);
+    return 0;
+}
+
+void cdn_rpc_cancel(cdn_rpc_req_t *req)
+{
+    cdn_rpc_t *rpc = req->rpc;
+    unsigned i = req->sock.port - rpc->port_base;
+    if (i < rpc->port_num && rpc->reqs[i] == req)
+        cdn_rpc_release(req);
+}
+
+int cdn_rpc_init(cdn_rpc_t *rpc, cdn_ns_t *ns, cd_timer_wheel_t *wheel,
+        uint16_t port_base, uint16_t port_num)
+{
+    cdn_assert(port_num && port_num <= CDN_RPC_PORT_MAX);
+    cdn_assert(port_base >= 0x40); // out of the well-known ports
+    memset(rpc, 0, sizeof(cdn_rpc_t));
+    rpc->ns = ns;
+    rpc->wheel = wheel;
+    rpc->port_base = port_base;
+    rpc->port_num = port_num;
+
+    // mark the tail bits of the last word as used
+    if (port_num & 31)
+        rpc->port_map[port_num / 32] = ~0u << (port_num & 31);
+    return 0;
+}
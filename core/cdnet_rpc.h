@@ -0,0 +1,78 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CDNET_RPC_H__
+#define __CDNET_RPC_H__
+
+#include "cdnet_core.h"
+#include "cd_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Request / response client
+//
+// Each request takes a free ephemeral port from the pool, and keeps it for all retransmissions,
+// so the server can recognize a retry and avoid re-execution.
+// Replies are matched by the socket table (the request's own socket), no scan,
+// and must come from the request dst (any node for multicast and broadcast requests).
+// Retries and timeouts are driven by the timer wheel, call cd_timer_run() in the main loop.
+
+#ifndef CDN_SOCK_TBL_BITS
+#error "cdnet_rpc requires CDN_SOCK_TBL_BITS, replies are looked up by port"
+#endif
+
+#ifndef CDN_RPC_PORT_MAX
+#define CDN_RPC_PORT_MAX        64      // multiple of 32
+#endif
+
+struct cdn_rpc;
+
+typedef struct cdn_rpc_req {
+    cdn_sock_t      sock;       // bound to the ephemeral port while pending
+    struct cdn_rpc  *rpc;
+
+    cdn_sockaddr_t  dst;
+    const uint8_t   *dat;       // request payload, must be kept until finished
+    uint8_t         len;
+    uint8_t         retry;      // retries left
+    uint32_t        timeout;    // unit: systick
+    cd_timer_t      tm;         // retry or timeout
+
+    // pkt: reply (freed after return), NULL: timeout
+    void            (*cb)(struct cdn_rpc_req *req, cdn_pkt_t *pkt);
+    void            *arg;
+} cdn_rpc_req_t;
+
+typedef struct cdn_rpc {
+    cdn_ns_t        *ns;
+    cd_timer_wheel_t *wheel;
+    uint16_t        port_base;  // ephemeral port range: [port_base, port_base + port_num)
+    uint16_t        port_num;
+    uint16_t        port_next;  // rotate the ports in use
+    uint32_t        port_map[CDN_RPC_PORT_MAX / 32]; // bit set: in use
+    cdn_rpc_req_t   *reqs[CDN_RPC_PORT_MAX];          // pending requests by port index
+
+    uint32_t        retry_cnt;  // statistics
+    uint32_t        timeout_cnt;
+    uint32_t        mismatch_cnt; // replies dropped, not from the request dst
+} cdn_rpc_t;
+
+
+int cdn_rpc_init(cdn_rpc_t *rpc, cdn_ns_t *ns, cd_timer_wheel_t *wheel,
+        uint16_t port_base, uint16_t port_num);
+int cdn_rpc_send(cdn_rpc_t *rpc, cdn_rpc_req_t *req);
+void cdn_rpc_cancel(cdn_rpc_req_t *req);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cdnet_stream.h"
+#include "cd_debug.h"
+
+#define SEG(st, seq)    (&(st)->segs[(uint16_t)(seq) % CDN_STREAM_WIN_MAX])
+
+
+static void ring_w(uint8_t *ring, uint16_t size, uint32_t pos, const uint8_t *dat, unsigned len)
+{
+    unsigned ofs = pos & (size - 1);
+    unsigned n = min(len, size - ofs);
+    memcpy(ring + ofs, dat, n);
+    memcpy(ring, dat + n, len - n);
+}
+
+static void ring_r(const uint8_t *ring, uint16_t size, uint32_t pos, uint8_t *dat, unsigned len)
+{
+    unsigned ofs = pos & (size - 1);
+    unsigned n = min(len, size - ofs);
+    memcpy(dat, ring + ofs, n);
+    memcpy(dat + n, ring, len - n);
+}
+
+static cdn_pkt_t *cdn_stream_pkt(cdn_stream_t *st)
+{
+    cdn_pkt_t *pkt = cdn_pkt_alloc(st->sock.ns);
+    if (pkt) {
+        pkt->dst = st->peer;
+        cdn_pkt_prepare(&st->sock, pkt);
+    }
+    return pkt;
+}
+
+static int cdn_stream_tx_seg(cdn_stream_t *st, uint16_t seq)
+{
+    cdn_stream_seg_t *seg = SEG(st, seq);
+    cdn_pkt_t *pkt = cdn_stream_pkt(st);
+    if (!pkt)
+        return -1;
+    pkt->dat[0] = CDN_STREAM_DATA;
+    put_unaligned16(seq, pkt->dat + 1);
+    put_unaligned16(seg->pos, pkt->dat + 3);
+    ring_r(st->tx_buf, st->tx_size, seg->pos, pkt->dat + 5, seg->len);
+    pkt->len = 5 + seg->len;
+    cd_timer_mod(st->wheel, &seg->tm, st->rto);
+    cdn_sock_sendto(&st->sock, pkt);
+    return 0;
+}
+
+static void cdn_stream_tx_ack(cdn_stream_t *st)
+{
+    cdn_pkt_t *pkt = cdn_stream_pkt(st);
+    if (!pkt)
+        return; // retry at next poll
+    uint32_t sack = 0;
+    for (int i = 0; i < CDN_STREAM_WIN_MAX - 1; i++) {
+        if (st->rcv_got[(uint16_t)(st->rcv_nxt + 1 + i) % CDN_STREAM_WIN_MAX])
+            sack |= 1u << i;
+    }
+    pkt->dat[0] = CDN_STREAM_ACK;
+    put_unaligned16(st->rcv_nxt, pkt->dat + 1);
+    put_unaligned32(sack, pkt->dat + 3);
+    put_unaligned16(st->rx_size - (st->rcv_pos - st->rd_pos), pkt->dat + 7);
+    pkt->len = 9;
+    cdn_sock_sendto(&st->sock, pkt);
+    st->ack_cnt = 0;
+    st->ack_now = false;
+    cd_timer_del(&st->ack_tm);
+}
+
+static void cdn_stream_ack_timeout(cd_timer_t *tm)
+{
+    cdn_stream_t *st = container_of(tm, cdn_stream_t, ack_tm);
+    st->ack_now = true; // kept for cdn_stream_poll if no free pkt
+    cdn_stream_tx_ack(st);
+}
+
+// resend a segment not sacked
+static void cdn_stream_rto(cd_timer_t *tm)
+{
+    cdn_stream_seg_t *seg = container_of(tm, cdn_stream_seg_t, tm);
+    cdn_stream_t *st = seg->st;
+    uint16_t seq = st->snd_una + ((seg - st->segs - st->snd_una) & (CDN_STREAM_WIN_MAX - 1));
+
+    if (seq == st->snd_una && st->retry_cnt >= st->max_retry) {
+        d_debug("stream: retry exceeded, seq %d\n", seq);
+        st->retry_cnt++; // reported by cdn_stream_poll
+        return;
+    }
+    if (cdn_stream_tx_seg(st, seq)) { // no free pkt, try at the next tick
+        cd_timer_mod(st->wheel, tm, 0);
+        return;
+    }
+    if (seq == st->snd_una)
+        st->retry_cnt++;
+    seg->fast = false;
+    st->retx_cnt++;
+}
+
+static void cdn_stream_probe(cd_timer_t *tm)
+{
+    cdn_stream_t *st = container_of(tm, cdn_stream_t, probe_tm);
+    cdn_pkt_t *pkt = cdn_stream_pkt(st);
+    if (!pkt) {
+        cd_timer_mod(st->wheel, tm, 0);
+        return;
+    }
+    pkt->dat[0] = CDN_STREAM_PROBE;
+    pkt->len = 1;
+    cdn_sock_sendto(&st->sock, pkt);
+}
+
+
+static void cdn_stream_rx_ack(cdn_stream_t *st, const uint8_t *dat)
+{
+    uint16_t ack = get_unaligned16(dat + 1);
+    uint32_t sack = get_unaligned32(dat + 3);
+    uint16_t inflight = st->snd_nxt - st->snd_una;
+    uint16_t acked = ack - st->snd_una;
+
+    if (acked > inflight)
+        return; // stale
+    st->peer_wnd = get_unaligned16(dat + 7);
+    cd_timer_del(&st->probe_tm); // re-armed by cdn_stream_poll if still blocked
+    if (acked) {
+        for (; st->snd_una != ack; st->snd_una++)
+            cd_timer_del(&SEG(st, st->snd_una)->tm);
+        st->retry_cnt = 0;
+    }
+
+    // mark sacked, count the segments received after the first hole
+    int above = 0;
+    for (int i = CDN_STREAM_WIN_MAX - 2; i >= 0; i--) {
+        uint16_t seq = ack + 1 + i;
+        if ((uint16_t)(seq - st->snd_una) >= (uint16_t)(st->snd_nxt - st->snd_una))
+            continue;
+        cdn_stream_seg_t *seg = SEG(st, seq);
+        if (sack & (1u << i)) {
+            seg->sacked = true;
+            cd_timer_del(&seg->tm);
+            above++;
+        } else if (above >= CDN_STREAM_DUPTHRESH && !seg->fast) {
+            if (cdn_stream_tx_seg(st, seq))
+                break;
+            seg->fast = true;
+            st->fast_retx_cnt++;
+        }
+    }
+    // the first hole: seq ack itself
+    if (st->snd_una != st->snd_nxt && above >= CDN_STREAM_DUPTHRESH) {
+        cdn_stream_seg_t *seg = SEG(st, ack);
+        if (!seg->fast && !cdn_stream_tx_seg(st, ack)) {
+            seg->fast = true;
+            st->fast_retx_cnt++;
+        }
+    }
+}
+
+static void cdn_stream_rx_data(cdn_stream_t *st, const uint8_t *dat, unsigned len)
+{
+    len -= 5;
+    uint16_t seq = get_unaligned16(dat + 1);
+    uint16_t d = seq - st->rcv_nxt;
+    uint32_t pos = st->rcv_pos + (int16_t)(get_unaligned16(dat + 3) - (uint16_t)st->rcv_pos);
+
+    if (d >= CDN_STREAM_WIN_MAX || pos + len - st->rd_pos > st->rx_size) {
+        // duplicate, or out of window / buffer
+        if (d < 0x8000)
+            st->rx_drop_cnt++;
+        st->ack_now = true;
+        return;
+    }
+    if (d || st->rcv_got[(seq + 1) % CDN_STREAM_WIN_MAX])
+        st->ack_now = true; // out of order, report by sack quickly
+    if (!st->ack_cnt++)
+        cd_timer_mod(st->wheel, &st->ack_tm, st->ack_delay);
+
+    unsigned i = seq % CDN_STREAM_WIN_MAX;
+    if (!st->rcv_got[i]) {
+        ring_w(st->rx_buf, st->rx_size, pos, dat + 5, len);
+        st->rcv_got[i] = true;
+        st->rcv_end[i] = pos + len;
+    }
+
+    while (st->rcv_got[(i = st->rcv_nxt % CDN_STREAM_WIN_MAX)]) {
+        st->rcv_got[i] = false;
+        st->rcv_pos = st->rcv_end[i];
+        st->rcv_nxt++;
+    }
+}
+
+static void cdn_stream_rx_cb(cdn_sock_t *sock, cdn_pkt_t *pkt)
+{
+    cdn_stream_t *st = container_of(sock, cdn_stream_t, sock);
+
+    if (pkt->src.port != st->peer.port || memcmp(pkt->src.addr, st->peer.addr, 3) || !pkt->len) {
+        d_verbose("stream: not from peer\n");
+    } else if (pkt->dat[0] == CDN_STREAM_DATA && pkt->len >= 5) {
+        cdn_stream_rx_data(st, pkt->dat, pkt->len);
+    } else if (pkt->dat[0] == CDN_STREAM_ACK && pkt->len >= 9) {
+        cdn_stream_rx_ack(st, pkt->dat);
+    } else if (pkt->dat[0] == CDN_STREAM_PROBE) {
+        st->ack_now = true;
+    }
+    cdn_pkt_free(sock->ns, pkt);
+}
+
+
+unsigned cdn_stream_write(cdn_stream_t *st, const uint8_t *dat, unsigned len)
+{
+    len = min(len, cdn_stream_tx_free(st));
+    ring_w(st->tx_buf, st->tx_size, st->tx_head, dat, len);
+    st->tx_head += len;
+    return len;
+}
+
+unsigned cdn_stream_read(cdn_stream_t *st, uint8_t *buf, unsigned len)
+{
+    unsigned wnd = st->rx_size - (st->rcv_pos - st->rd_pos);
+    len = min(len, cdn_stream_rx_avail(st));
+    ring_r(st->rx_buf, st->rx_size, st->rd_pos, buf, len);
+    st->rd_pos += len;
+    if (len && wnd < 2 * st->mss)
+        st->ack_now = true; // window update
+    return len;
+}
+
+int cdn_stream_poll(cdn_stream_t *st)
+{
+    if (st->retry_cnt > st->max_retry)
+        return -1;
+
+    if (st->ack_now || st->ack_cnt >= st->ack_every)
+        cdn_stream_tx_ack(st);
+
+    // new segments, coalesce small writes while data is in flight (nagle)
+    while ((uint16_t)(st->snd_nxt - st->snd_una) < st->win) {
+        unsigned len = min(st->tx_head - st->tx_seg, (uint32_t)st->mss);
+        if (!len) {
+            st->push = false;
+            break;
+        }
+        if (len < st->mss && st->snd_una != st->snd_nxt && !st->nodelay && !st->push)
+            break;
+        uint32_t una = st->snd_una == st->snd_nxt ? st->tx_seg : SEG(st, st->snd_una)->pos;
+        if (st->tx_seg + len - una > st->peer_wnd) {
+            // no ack will come back by itself, probe the window after rto
+            if (st->snd_una == st->snd_nxt && !cd_timer_pending(&st->probe_tm))
+                cd_timer_mod(st->wheel, &st->probe_tm, st->rto);
+            break;
+        }
+
+        cdn_stream_seg_t *seg = SEG(st, st->snd_nxt);
+        seg->pos = st->tx_seg;
+        seg->len = len;
+        seg->sacked = false;
+        seg->fast = false;
+        if (cdn_stream_tx_seg(st, st->snd_nxt))
+            break;
+        st->tx_seg += len;
+        st->snd_nxt++;
+    }
+    return 0;
+}
+
+
+int cdn_stream_init(cdn_stream_t *st, cdn_ns_t *ns, cd_timer_wheel_t *wheel,
+        uint16_t port, const cdn_sockaddr_t *peer)
+{
+    cdn_assert(st->tx_size && !(st->tx_size & (st->tx_size - 1)));
+    cdn_assert(st->rx_size && !(st->rx_size & (st->rx_size - 1)));
+    if (!st->win || st->win > CDN_STREAM_WIN_MAX - 1)
+        st->win = CDN_STREAM_WIN_MAX - 1;
+    if (!st->mss)
+        st->mss = min(CD_FRAME_SIZE - 2 - 3 - 9 - 5, 255); // uart crc, frame and max level 1 header
+    if (!st->max_retry)
+        st->max_retry = 5;
+    if (!st->rto)
+        st->rto = 100000 / CD_SYSTICK_US_DIV; // 100 ms
+    if (!st->ack_every)
+        st->ack_every = max(st->win / 4, 1);
+    if (!st->ack_delay)
+        st->ack_delay = 2000 / CD_SYSTICK_US_DIV; // 2 ms
+
+    st->peer = *peer;
+    st->wheel = wheel;
+    st->tx_head = st->tx_seg = 0;
+    st->snd_una = st->snd_nxt = 0;
+    st->peer_wnd = st->mss; // until the first ack
+    st->push = false;
+    st->retry_cnt = 0;
+    st->probe_tm.pprev = st->ack_tm.pprev = NULL;
+    st->probe_tm.cb = cdn_stream_probe;
+    st->ack_tm.cb = cdn_stream_ack_timeout;
+    for (int i = 0; i < CDN_STREAM_WIN_MAX; i++) {
+        st->segs[i].tm.pprev = NULL;
+        st->segs[i].tm.cb = cdn_stream_rto;
+        st->segs[i].st = st;
+    }
+    st->rd_pos = st->rcv_pos = 0;
+    st->rcv_nxt = 0;
+    st->ack_cnt = 0;
+    st->ack_now = false;
+    memset(st->rcv_got, 0, sizeof(st->rcv_got));
+    st->retx_cnt = st->fast_retx_cnt = st->rx_drop_cnt = 0;
+
+    memset(&st->sock, 0, sizeof(cdn_sock_t));
+    st->sock.ns = ns;
+    st->sock.port = port;
+    st->sock.rx_cb = cdn_stream_rx_cb;
+    return cdn_sock_bind(&st->sock);
+}
+
+void cdn_stream_deinit(cdn_stream_t *st)
+{
+    cdn_sock_unbind(&st->sock);
+    cd_timer_del(&st->probe_tm);
+    cd_timer_del(&st->ack_tm);
+    for (int i = 0; i < CDN_STREAM_WIN_MAX; i++)
+        cd_timer_del(&st->segs[i].tm);
+}
@@ -0,0 +1,128 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CDNET_STREAM_H__
+#define __CDNET_STREAM_H__
+
+#include "cdnet_core.h"
+#include "cd_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reliable ordered byte stream between two sockets, full duplex, no handshake
+// (both ends start from seq 0 after init).
+//
+// Data:  [0x00, seq_l, seq_h, pos_l, pos_h] + data
+//   seq: segment number, pos: low 16 bits of the byte position in the stream
+// Ack:   [0x80, ack_l, ack_h, sack (4 bytes), wnd_l, wnd_h]
+//   ack: next seq expected, sack bit n: seq ack+1+n received, wnd: free rx buffer
+// Probe: [0x81], request an ack (window update) from the peer
+//
+// Acks are sent from cdn_stream_poll: every ack_every in-order segments or after ack_delay,
+// at once for out of order segments, duplicates, probes and window updates.
+// A hole is retransmitted once CDN_STREAM_DUPTHRESH segments after it are sacked,
+// or after the rto.
+// The rto, ack_delay and probe timers are driven by the timer wheel, call cd_timer_run() in the main loop.
+
+#define CDN_STREAM_WIN_MAX      32      // segments in flight, limited by the sack bitmap
+
+#ifndef CDN_STREAM_DUPTHRESH
+#define CDN_STREAM_DUPTHRESH    3
+#endif
+
+#define CDN_STREAM_DATA         0x00
+#define CDN_STREAM_ACK          0x80
+#define CDN_STREAM_PROBE        0x81
+
+struct cdn_stream;
+
+typedef struct {
+    uint32_t        pos;        // byte position in the stream
+    cd_timer_t      tm;         // rto, pending while in flight and not sacked
+    struct cdn_stream *st;
+    uint8_t         len;
+    bool            sacked;
+    bool            fast;       // fast retransmitted, cleared by rto
+} cdn_stream_seg_t;
+
+typedef struct cdn_stream {
+    cdn_sock_t      sock;
+    cdn_sockaddr_t  peer;
+    cd_timer_wheel_t *wheel;
+
+    // set by user before init, sizes must be power of 2
+    uint8_t         *tx_buf;
+    uint8_t         *rx_buf;
+    uint16_t        tx_size;
+    uint16_t        rx_size;
+    uint8_t         win;        // segments in flight, 1 ~ CDN_STREAM_WIN_MAX
+    uint8_t         mss;        // max payload per segment
+    bool            nodelay;    // disable the coalescing of small writes
+    uint8_t         max_retry;
+    uint8_t         ack_every;
+    uint32_t        ack_delay;  // unit: systick
+    uint32_t        rto;
+
+    // tx
+    uint32_t        tx_head;    // write position
+    uint32_t        tx_seg;     // end of the data put into segments
+    uint16_t        snd_una;    // oldest seq not acked
+    uint16_t        snd_nxt;
+    uint16_t        peer_wnd;
+    bool            push;
+    uint8_t         retry_cnt;
+    cd_timer_t      probe_tm;   // window probe while nothing is in flight
+    cdn_stream_seg_t segs[CDN_STREAM_WIN_MAX];
+
+    // rx
+    uint32_t        rd_pos;     // read position
+    uint32_t        rcv_pos;    // end of the contiguous data received
+    uint16_t        rcv_nxt;
+    uint8_t         ack_cnt;    // in-order segments not acked
+    bool            ack_now;
+    cd_timer_t      ack_tm;     // ack_delay since the first segment not acked
+    bool            rcv_got[CDN_STREAM_WIN_MAX];
+    uint32_t        rcv_end[CDN_STREAM_WIN_MAX];
+
+    uint32_t        retx_cnt;   // statistics
+    uint32_t        fast_retx_cnt;
+    uint32_t        rx_drop_cnt;
+} cdn_stream_t;
+
+
+int cdn_stream_init(cdn_stream_t *st, cdn_ns_t *ns, cd_timer_wheel_t *wheel,
+        uint16_t port, const cdn_sockaddr_t *peer);
+void cdn_stream_deinit(cdn_stream_t *st);
+unsigned cdn_stream_write(cdn_stream_t *st, const uint8_t *dat, unsigned len);
+unsigned cdn_stream_read(cdn_stream_t *st, uint8_t *buf, unsigned len);
+int cdn_stream_poll(cdn_stream_t *st); // return < 0 if retry exceeded
+
+static inline void cdn_stream_flush(cdn_stream_t *st)
+{
+    st->push = true;
+}
+
+static inline unsigned cdn_stream_tx_free(const cdn_stream_t *st)
+{
+    uint32_t una = st->snd_una == st->snd_nxt ? st->tx_seg : st->segs[st->snd_una % CDN_STREAM_WIN_MAX].pos;
+    return st->tx_size - (st->tx_head - una);
+}
+
+static inline unsigned cdn_stream_rx_avail(const cdn_stream_t *st)
+{
+    return st->rcv_pos - st->rd_pos;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,6 +12,8 @@
 
 #include "cd_utils.h"
 #include "cd_list.h"
+#include "cd_capture.h"
+#include "cd_trace.h"
 
 // 256 bytes are enough for the CDCTL controller (without CRC)
 // 258 bytes are enough for the UART controller (with CRC)
@@ -20,11 +22,59 @@
 #define CD_FRAME_SIZE   256
 #endif
 
+// share one frame between multiple owners (e.g. multicast pkts and a tx queue),
+// a user defined cd_frame_t must provide the same `ref` field
+//#define CD_FRAME_REF
+
+// size classed frame pools: dat sizes in descending order, class 0 must be CD_FRAME_SIZE,
+// the free lists of all classes are adjacent: free_head[cls] (plain cd_list_get(free_head) gets class 0),
+// a frame of smaller class is a cd_frame_t truncated to its size,
+// a user defined cd_frame_t must provide the same `cls` field
+//#define CD_FRAME_CLASS_SIZES    { CD_FRAME_SIZE, 40 }
+
+// tx priority levels: frm->prio 0 (default) ~ CD_TX_PRIO_NUM - 1 (highest),
+// devices always dequeue the highest priority first,
+// a user defined cd_frame_t must provide the same `prio` field
+//#define CD_TX_PRIO_NUM          2
+
+#ifdef CD_FRAME_REF
+#define _CD_FRAME_REF_N     1
+#else
+#define _CD_FRAME_REF_N     0
+#endif
+#ifdef CD_FRAME_CLASS_SIZES
+#define _CD_FRAME_CLS_N     1
+#else
+#define _CD_FRAME_CLS_N     0
+#endif
+#ifdef CD_TX_PRIO_NUM
+#define _CD_FRAME_PRIO_N    1
+#else
+#define _CD_FRAME_PRIO_N    0
+#endif
+#define _CD_FRAME_OPT_N     (_CD_FRAME_REF_N + _CD_FRAME_CLS_N + _CD_FRAME_PRIO_N)
+
+// the byte before dat is borrowed by cdctl_it (spi command), so it is never an option byte
+#ifdef CD_FRAME_PAD
+#define _CD_FRAME_PAD_LEN   (((1 - _CD_FRAME_OPT_N) & 3) ? ((1 - _CD_FRAME_OPT_N) & 3) : 4)
+#else
+#define _CD_FRAME_PAD_LEN   (_CD_FRAME_OPT_N ? 1 : 0)
+#endif
+
 #ifndef CD_FRAME_TYPE
 typedef struct {
     list_node_t node;
-#ifdef CD_FRAME_PAD
-    uint8_t     _pad; // align body (dat+3) to 32-bit, for dma (e.g. esp32xx)
+#ifdef CD_FRAME_REF
+    uint8_t     ref;  // extra owners
+#endif
+#ifdef CD_FRAME_CLASS_SIZES
+    uint8_t     cls;  // size class
+#endif
+#ifdef CD_TX_PRIO_NUM
+    uint8_t     prio; // tx priority
+#endif
+#if _CD_FRAME_PAD_LEN
+    uint8_t     _pad[_CD_FRAME_PAD_LEN]; // align body (dat+3) to 32-bit for dma (e.g. esp32xx) if CD_FRAME_PAD
 #endif
     uint8_t     dat[CD_FRAME_SIZE];
 } cd_frame_t;
@@ -40,15 +90,159 @@ _Static_assert((offsetof(cd_frame_t, dat) + 3) % 4 == 0, "dat+3 must be 32-bit a
 #define cd_list_get(head)               list_get_entry_it(head, cd_frame_t)
 #define cd_list_get_last(head)          list_get_last_entry_it(head, cd_frame_t)
 #define cd_list_put(head, frm)          list_put_it(head, &(frm)->node)
+#define cd_list_put_list(head, src)     list_put_list_it(head, src)
 #elif !defined(CD_USER_LIST)
 #define cd_list_get(head)               list_get_entry(head, cd_frame_t)
 #define cd_list_get_last(head)          list_get_last_entry(head, cd_frame_t)
 #define cd_list_put(head, frm)          list_put(head, &(frm)->node)
+#define cd_list_put_list(head, src)     list_put_list(head, src)
+#endif
+
+
+#ifdef CD_FRAME_CLASS_SIZES
+
+static const uint16_t cd_frame_class_size[] = CD_FRAME_CLASS_SIZES;
+#define CD_FRAME_CLASS_NUM  (sizeof(cd_frame_class_size) / sizeof(cd_frame_class_size[0]))
+
+// memory size of a frame with dat_size bytes of dat, for the pool buffers
+#define CD_FRAME_STRIDE(dat_size) \
+    ((offsetof(cd_frame_t, dat) + (dat_size) + __alignof__(cd_frame_t) - 1) & ~(__alignof__(cd_frame_t) - 1))
+
+#define cd_frame_size(frm)          (cd_frame_class_size[(frm)->cls])
+#define cd_frame_head(head, frm)    ((head) + (frm)->cls)
+
+// smallest free frame with at least size bytes of dat, promote to larger classes if empty
+static inline cd_frame_t *cd_frame_get_fit(list_head_t *free_head, unsigned size)
+{
+    for (int cls = CD_FRAME_CLASS_NUM - 1; cls >= 0; cls--) {
+        if (cd_frame_class_size[cls] < size)
+            continue;
+        cd_frame_t *frm = cd_list_get(free_head + cls);
+        if (frm)
+            return frm;
+    }
+    return NULL;
+}
+
+// split mem (aligned) into frames of class cls, put them to free_head[cls]
+static inline void cd_frame_pool_init(list_head_t *free_head, int cls, void *mem, unsigned mem_size)
+{
+    unsigned stride = CD_FRAME_STRIDE(cd_frame_class_size[cls]);
+    for (unsigned ofs = 0; ofs + stride <= mem_size; ofs += stride) {
+        cd_frame_t *frm = (cd_frame_t *)((uint8_t *)mem + ofs);
+        frm->cls = cls;
+#ifdef CD_FRAME_REF
+        frm->ref = 0;
 #endif
+        cd_list_put(free_head + cls, frm);
+    }
+}
+
+#else
+#define cd_frame_size(frm)          CD_FRAME_SIZE
+#define cd_frame_head(head, frm)    (head)
+#define cd_frame_get_fit(head, size) cd_list_get(head)
+#endif
+
+
+#ifdef CD_FRAME_REF
+// the lock of the free list (class 0) protects the ref of its frames
+
+static inline void cd_frame_ref(list_head_t *free_head, cd_frame_t *frm)
+{
+#ifdef CD_IRQ_SAFE
+    uint32_t flags;
+    cd_irq_save(&free_head->lock, flags);
+    frm->ref++;
+    cd_irq_restore(&free_head->lock, flags);
+#else
+    (void)free_head;
+    frm->ref++;
+#endif
+}
+
+// return the frame to the free list on the last release
+static inline void cd_frame_free(list_head_t *free_head, cd_frame_t *frm)
+{
+    bool last;
+#ifdef CD_IRQ_SAFE
+    uint32_t flags;
+    cd_irq_save(&free_head->lock, flags);
+#endif
+    last = !frm->ref;
+    if (!last)
+        frm->ref--;
+#ifdef CD_IRQ_SAFE
+    cd_irq_restore(&free_head->lock, flags);
+#endif
+    if (last)
+        cd_list_put(cd_frame_head(free_head, frm), frm);
+}
+#else
+#define cd_frame_free(head, frm)        cd_list_put(cd_frame_head(head, frm), frm)
+#endif
+
+#ifdef CD_TX_PRIO_NUM
+typedef struct {
+    list_head_t     q[CD_TX_PRIO_NUM];
+} cd_tx_head_t;
+
+static inline cd_frame_t *_cd_tx_get(cd_tx_head_t *head)
+{
+    for (int i = CD_TX_PRIO_NUM - 1; i >= 0; i--) {
+        if (head->q[i].len) {
+            cd_frame_t *frm = cd_list_get(&head->q[i]);
+            if (frm)
+                return frm;
+        }
+    }
+    return NULL;
+}
+
+static inline void cd_tx_put(cd_tx_head_t *head, cd_frame_t *frm)
+{
+    cd_list_put(&head->q[min(frm->prio, CD_TX_PRIO_NUM - 1)], frm);
+}
+
+// frames become empty
+static inline void cd_tx_put_list(cd_tx_head_t *head, list_head_t *frames)
+{
+    cd_frame_t *frm;
+    while ((frm = list_get_entry(frames, cd_frame_t)) != NULL)
+        cd_tx_put(head, frm);
+}
+
+static inline uint32_t cd_tx_len(const cd_tx_head_t *head)
+{
+    uint32_t len = 0;
+    for (int i = 0; i < CD_TX_PRIO_NUM; i++)
+        len += head->q[i].len;
+    return len;
+}
+
+#define cd_tx_head_init(head)       memset(head, 0, sizeof(cd_tx_head_t))
+#else
+typedef list_head_t cd_tx_head_t;
+#define _cd_tx_get(head)            cd_list_get(head)
+#define cd_tx_put(head, frm)        cd_list_put(head, frm)
+#define cd_tx_put_list(head, src)   cd_list_put_list(head, src)
+#define cd_tx_len(head)             ((head)->len)
+#define cd_tx_head_init(head)       list_head_init(head)
+#endif
+
+// tx consumer of the drivers
+static inline cd_frame_t *cd_tx_get(cd_tx_head_t *head)
+{
+    cd_frame_t *frm = _cd_tx_get(head);
+    if (frm)
+        cd_trace_pt(CD_TRACE_TX, 0, frm);
+    return frm;
+}
 
 typedef struct cd_dev {
     cd_frame_t *(* recv_frame)(struct cd_dev *cd_dev);
     void (* send_frame)(struct cd_dev *cd_dev, cd_frame_t *frame);
+    void (* send_frames)(struct cd_dev *cd_dev, list_head_t *frames); // optional, frames become empty
 } cd_dev_t;
 
 #endif
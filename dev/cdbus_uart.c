@@ -20,18 +20,131 @@ static cd_frame_t *cduart_recv_frame(cd_dev_t *cd_dev)
 static void cduart_send_frame(cd_dev_t *cd_dev, cd_frame_t *frame)
 {
     cduart_dev_t *dev = container_of(cd_dev, cduart_dev_t, cd_dev);
-    cd_list_put(&dev->tx_head, frame);
+    cd_tx_put(&dev->tx_head, frame);
 }
 
+static void cduart_send_frames(cd_dev_t *cd_dev, list_head_t *frames)
+{
+    cduart_dev_t *dev = container_of(cd_dev, cduart_dev_t, cd_dev);
+    cd_tx_put_list(&dev->tx_head, frames);
+}
+
+
+#ifdef CD_FRAME_CLASS_SIZES
+// move the header to the smallest frame class fits the length byte, NULL if no room
+static cd_frame_t *cduart_fit_frame(cduart_dev_t *dev, cd_frame_t *frame)
+{
+    unsigned need = frame->dat[2] + 5;
+    unsigned size = cd_frame_size(frame);
+    if (need <= size && (frame->cls == CD_FRAME_CLASS_NUM - 1 || need > cd_frame_class_size[frame->cls + 1]))
+        return frame;
+
+    cd_frame_t *frm = cd_frame_get_fit(dev->free_head, need);
+    if (frm && (need > size || cd_frame_size(frm) < size)) {
+        memcpy(frm->dat, frame->dat, 3);
+        cd_list_put(cd_frame_head(dev->free_head, frame), frame);
+        return frm;
+    }
+    if (frm)
+        cd_list_put(cd_frame_head(dev->free_head, frm), frm);
+    return need <= size ? frame : NULL;
+}
+#endif
+
+
+static void cduart_rx_put(cduart_dev_t *dev)
+{
+    cd_frame_t *frame = dev->rx_frame;
+    cd_cap_dev_frame(CD_CAP_RX, dev->cap_id, frame->dat);
+    cd_frame_t *frm = cd_frame_get_fit(dev->free_head, 5);
+    if (frm) {
+#ifdef CD_VERBOSE
+        char pbuf[52];
+        hex_dump_small(pbuf, frame->dat, frame->dat[2] + 3, 16);
+        dn_verbose(dev->name, "-> [%s]\n", pbuf);
+#endif
+        cd_trace_pt(CD_TRACE_DEV_RX, 0, frame);
+        cd_list_put(&dev->rx_head, frame);
+        dev->rx_frame = frm;
+    } else {
+        // set rx_lost flag
+        dn_error(dev->name, "rx_lost\n");
+    }
+}
+
+
+#ifdef CDUART_HUNT
+// dat: bytes of the broken frame after its first byte
+static void cduart_hunt_start(cduart_dev_t *dev, const uint8_t *dat, unsigned len)
+{
+    memcpy(dev->hunt_buf, dat, len);
+    dev->hunt_ofs = 0;
+    dev->hunt_len = len;
+    dev->hunting = true;
+    dev->hunt_cnt++;
+}
+
+// append the new bytes, slide by one byte until a valid frame is at the head of the window,
+// return bytes consumed, back to the normal parser once the window is emptied by a valid frame
+static unsigned cduart_hunt(cduart_dev_t *dev, const uint8_t *rd, unsigned max_len)
+{
+    if (dev->hunt_ofs + dev->hunt_len + max_len > CD_FRAME_SIZE) {
+        memmove(dev->hunt_buf, dev->hunt_buf + dev->hunt_ofs, dev->hunt_len);
+        dev->hunt_ofs = 0;
+    }
+    unsigned cpy_len = min(max_len, CD_FRAME_SIZE - dev->hunt_ofs - dev->hunt_len);
+    memcpy(dev->hunt_buf + dev->hunt_ofs + dev->hunt_len, rd, cpy_len);
+    dev->hunt_len += cpy_len;
+
+    while (dev->hunt_len >= 3) {
+        uint8_t *p = dev->hunt_buf + dev->hunt_ofs;
+        unsigned need = p[2] + 5;
+
+        if (p[2] <= CD_FRAME_SIZE - 5) {
+            if (dev->hunt_len < need)
+                break; // a full frame fits the window, wait for the rest
+            if (CDUART_CRC_SUB(p, need, 0xffff) == 0) {
+                bool for_me = dev->local_mac == 0xff || p[1] == 0xff || p[1] == dev->local_mac;
+                cd_frame_t *frame = dev->rx_frame;
+#ifdef CD_FRAME_CLASS_SIZES
+                memcpy(frame->dat, p, 3);
+                frame = for_me ? cduart_fit_frame(dev, frame) : NULL;
+                if (frame)
+                    dev->rx_frame = frame;
+                else if (for_me)
+                    dn_error(dev->name, "drop, no free frame for len %d\n", p[2]);
+#endif
+                if (for_me && frame) {
+                    memcpy(frame->dat, p, need);
+                    cduart_rx_put(dev);
+                }
+                dev->hunt_ofs += need;
+                dev->hunt_len -= need;
+                if (!dev->hunt_len) {
+                    dn_debug(dev->name, "resync, total skip: %d\n", dev->hunt_skip);
+                    dev->hunting = false;
+                }
+                continue;
+            }
+        }
+        dev->hunt_ofs++;
+        dev->hunt_len--;
+        dev->hunt_skip++;
+    }
+    return cpy_len;
+}
+#endif
+
 
 void cduart_dev_init(cduart_dev_t *dev, list_head_t *free_head)
 {
     if (!dev->name)
         dev->name = "cduart";
-    dev->rx_frame = cd_list_get(free_head);
+    dev->rx_frame = cd_frame_get_fit(free_head, 5);
     dev->free_head = free_head;
     dev->cd_dev.recv_frame = cduart_recv_frame;
     dev->cd_dev.send_frame = cduart_send_frame;
+    dev->cd_dev.send_frames = cduart_send_frames;
 
     dev->t_last = get_systick();
     dev->rx_crc = 0xffff;
@@ -39,7 +152,7 @@ void cduart_dev_init(cduart_dev_t *dev, list_head_t *free_head)
 
 #ifdef CD_USE_DYNAMIC_INIT
     list_head_init(&dev->rx_head);
-    list_head_init(&dev->tx_head);
+    cd_tx_head_init(&dev->tx_head);
     dev->rx_byte_cnt = 0;
     dev->rx_drop = false;
 #endif
@@ -62,12 +175,27 @@ void cduart_rx_handle(cduart_dev_t *dev, const uint8_t *buf, unsigned len)
             dev->rx_crc = 0xffff;
             dev->rx_drop = false;
         }
+#ifdef CDUART_HUNT
+        if (dev->hunting && get_systick() - dev->t_last > CDUART_IDLE_TIME) {
+            dn_warn(dev->name, "hunt timeout, drop: %d\n", dev->hunt_len);
+            dev->hunt_skip += dev->hunt_len;
+            dev->hunt_len = 0;
+            dev->hunting = false;
+        }
+#endif
 
         if (!len || rd == buf + len)
             return;
         max_len = buf + len - rd;
         dev->t_last = get_systick();
 
+#ifdef CDUART_HUNT
+        if (dev->hunting) {
+            rd += cduart_hunt(dev, rd, max_len);
+            continue;
+        }
+#endif
+
         if (dev->rx_byte_cnt < 3)
             cpy_len = min(3 - dev->rx_byte_cnt, max_len);
         else
@@ -77,12 +205,35 @@ void cduart_rx_handle(cduart_dev_t *dev, const uint8_t *buf, unsigned len)
             memcpy(frame->dat + dev->rx_byte_cnt, rd, cpy_len);
         dev->rx_byte_cnt += cpy_len;
 
+#ifdef CDUART_HUNT
+        if (dev->rx_byte_cnt == 3 && frame->dat[2] > CD_FRAME_SIZE - 5) {
+            dn_warn(dev->name, "bad len, hdr: %02x %02x %02x\n", frame->dat[0], frame->dat[1], frame->dat[2]);
+            rd += cpy_len;
+            dev->rx_byte_cnt = 0;
+            dev->rx_crc = 0xffff;
+            dev->rx_drop = false;
+            cduart_hunt_start(dev, frame->dat + 1, 2);
+            continue;
+        }
+#endif
         if (dev->rx_byte_cnt == 3 && (frame->dat[2] > CD_FRAME_SIZE - 5 ||
                 (dev->local_mac != 0xff && frame->dat[1] != 0xff && frame->dat[1] != dev->local_mac))) {
             dn_warn(dev->name, "drop, hdr: %02x %02x %02x\n", frame->dat[0], frame->dat[1], frame->dat[2]);
             dev->rx_drop = true;
         }
 
+#ifdef CD_FRAME_CLASS_SIZES
+        if (dev->rx_byte_cnt == 3 && !dev->rx_drop) {
+            cd_frame_t *frm = cduart_fit_frame(dev, frame);
+            if (!frm) {
+                dn_error(dev->name, "drop, no free frame for len %d\n", frame->dat[2]);
+                dev->rx_drop = true;
+            } else {
+                frame = dev->rx_frame = frm;
+            }
+        }
+#endif
+
         if (!dev->rx_drop)
             dev->rx_crc = CDUART_CRC_SUB(rd, cpy_len, dev->rx_crc);
         rd += cpy_len;
@@ -92,20 +243,12 @@ void cduart_rx_handle(cduart_dev_t *dev, const uint8_t *buf, unsigned len)
                 if (dev->rx_crc != 0) {
                     dn_error(dev->name, "crc error, hdr: %02x %02x %02x\n",
                             frame->dat[0], frame->dat[1], frame->dat[2]);
-                } else {
-                    cd_frame_t *frm = cd_list_get(dev->free_head);
-                    if (frm) {
-#ifdef CD_VERBOSE
-                        char pbuf[52];
-                        hex_dump_small(pbuf, frame->dat, frame->dat[2] + 3, 16);
-                        dn_verbose(dev->name, "-> [%s]\n", pbuf);
+                    cd_cap_dev_frame(CD_CAP_RX | CD_CAP_ERR, dev->cap_id, frame->dat);
+#ifdef CDUART_HUNT
+                    cduart_hunt_start(dev, frame->dat + 1, frame->dat[2] + 4);
 #endif
-                        cd_list_put(&dev->rx_head, dev->rx_frame);
-                        dev->rx_frame = frm;
-                    } else {
-                        // set rx_lost flag
-                        dn_error(dev->name, "rx_lost\n");
-                    }
+                } else {
+                    cduart_rx_put(dev);
                 }
             }
             dev->rx_byte_cnt = 0;
@@ -27,19 +27,34 @@ extern "C" {
 #define CDUART_CRC_SUB      crc16_sub
 #endif
 
+// on a crc error or a bad length, search the received bytes for the next offset with a valid frame,
+// instead of dropping by the broken length or waiting for the idle time
+//#define CDUART_HUNT
+
 typedef struct cduart_dev {
     cd_dev_t            cd_dev;
     const char          *name;
+#ifdef CD_CAPTURE_DEV
+    uint8_t             cap_id;     // capture interface id
+#endif
 
     list_head_t         *free_head;
     list_head_t         rx_head;
-    list_head_t         tx_head;
+    cd_tx_head_t        tx_head;    // tx consumer: cd_tx_get(&dev->tx_head)
 
     cd_frame_t          *rx_frame;  // init: != NULL
     uint16_t            rx_byte_cnt;
     uint16_t            rx_crc;
     bool                rx_drop;
     uint32_t            t_last;     // last receive time
+#ifdef CDUART_HUNT
+    bool                hunting;
+    uint16_t            hunt_ofs;
+    uint16_t            hunt_len;
+    uint8_t             hunt_buf[CD_FRAME_SIZE]; // bytes not yet matched to a valid frame
+    uint32_t            hunt_cnt;   // resync times
+    uint32_t            hunt_skip;  // bytes discarded while hunting
+#endif
 
     uint8_t             local_mac;
 } cduart_dev_t;
@@ -48,7 +48,13 @@ cd_frame_t *cdctl_recv_frame(cd_dev_t *cd_dev)
 void cdctl_send_frame(cd_dev_t *cd_dev, cd_frame_t *frame)
 {
     cdctl_dev_t *dev = container_of(cd_dev, cdctl_dev_t, cd_dev);
-    cd_list_put(&dev->tx_head, frame);
+    cd_tx_put(&dev->tx_head, frame);
+}
+
+void cdctl_send_frames(cd_dev_t *cd_dev, list_head_t *frames)
+{
+    cdctl_dev_t *dev = container_of(cd_dev, cdctl_dev_t, cd_dev);
+    cd_tx_put_list(&dev->tx_head, frames);
 }
 
 
@@ -105,10 +111,11 @@ int cdctl_dev_init(cdctl_dev_t *dev, list_head_t *free_head, cdctl_cfg_t *init,
     dev->free_head = free_head;
     dev->cd_dev.recv_frame = cdctl_recv_frame;
     dev->cd_dev.send_frame = cdctl_send_frame;
+    dev->cd_dev.send_frames = cdctl_send_frames;
 
 #ifdef CD_USE_DYNAMIC_INIT
     list_head_init(&dev->rx_head);
-    list_head_init(&dev->tx_head);
+    cd_tx_head_init(&dev->tx_head);
     dev->is_pending = NULL;
     dev->rx_cnt = 0;
     dev->tx_cnt = 0;
@@ -194,11 +201,13 @@ void cdctl_poll(cdctl_dev_t *dev)
             hex_dump_small(pbuf, frame->dat, frame->dat[2] + 3, 16);
             dn_verbose(dev->name, "-> [%s]\n", pbuf);
 #endif
+            cd_cap_dev_frame(ret ? CD_CAP_RX | CD_CAP_ERR : CD_CAP_RX, dev->cap_id, frame->dat);
             if (ret) {
                 dn_error(dev->name, "rx frame len err\n");
                 cd_list_put(dev->free_head, frame);
                 dev->rx_len_err_cnt++;
             } else {
+                cd_trace_pt(CD_TRACE_DEV_RX, 0, frame);
                 cd_list_put(&dev->rx_head, frame);
                 dev->rx_cnt++;
             }
@@ -209,8 +218,9 @@ void cdctl_poll(cdctl_dev_t *dev)
     }
 
     if (!dev->is_pending) {
-        if (dev->tx_head.first) {
-            cd_frame_t *frame = cd_list_get(&dev->tx_head);
+        if (cd_tx_len(&dev->tx_head)) {
+            cd_frame_t *frame = cd_tx_get(&dev->tx_head);
+            cd_cap_dev_frame(CD_CAP_TX, dev->cap_id, frame->dat);
             cdctl_write_frame(dev, frame);
             dev->tx_cnt++;
 
@@ -226,7 +236,7 @@ void cdctl_poll(cdctl_dev_t *dev)
             dn_verbose(dev->name, "<- [%s]%s\n", pbuf, dev->is_pending ? " (p)" : "");
 #endif
 #ifndef CDCTL_TX_NOT_FREE
-            cd_list_put(dev->free_head, frame);
+            cd_frame_free(dev->free_head, frame);
 #endif
         }
     } else {
@@ -40,10 +40,8 @@ cd_frame_t *cdctl_recv_frame(cd_dev_t *cd_dev)
     return cd_list_get(&dev->rx_head);
 }
 
-void cdctl_send_frame(cd_dev_t *cd_dev, cd_frame_t *frame)
+static void cdctl_tx_kick(cdctl_dev_t *dev)
 {
-    cdctl_dev_t *dev = container_of(cd_dev, cdctl_dev_t, cd_dev);
-    cd_list_put(&dev->tx_head, frame);
 retry:
     irq_disable(dev->int_irq);
     if (dev->state == CDCTL_IDLE || dev->state == CDCTL_WAIT_TX_CLEAN)
@@ -55,6 +53,20 @@ retry:
         goto retry;
 }
 
+void cdctl_send_frame(cd_dev_t *cd_dev, cd_frame_t *frame)
+{
+    cdctl_dev_t *dev = container_of(cd_dev, cdctl_dev_t, cd_dev);
+    cd_tx_put(&dev->tx_head, frame);
+    cdctl_tx_kick(dev);
+}
+
+void cdctl_send_frames(cd_dev_t *cd_dev, list_head_t *frames)
+{
+    cdctl_dev_t *dev = container_of(cd_dev, cdctl_dev_t, cd_dev);
+    cd_tx_put_list(&dev->tx_head, frames);
+    cdctl_tx_kick(dev);
+}
+
 
 void cdctl_set_baud_rate(cdctl_dev_t *dev, uint32_t low, uint32_t high)
 {
@@ -111,11 +123,12 @@ int cdctl_dev_init(cdctl_dev_t *dev, list_head_t *free_head, cdctl_cfg_t *init,
     dev->free_head = free_head;
     dev->cd_dev.recv_frame = cdctl_recv_frame;
     dev->cd_dev.send_frame = cdctl_send_frame;
+    dev->cd_dev.send_frames = cdctl_send_frames;
 
 #ifdef CD_USE_DYNAMIC_INIT
     dev->state = CDCTL_RST;
     list_head_init(&dev->rx_head);
-    list_head_init(&dev->tx_head);
+    cd_tx_head_init(&dev->tx_head);
     dev->tx_wait_trigger = NULL;
     dev->tx_buf_clean_mask = false;
     dev->rx_cnt = 0;
@@ -251,8 +264,9 @@ void cdctl_spi_isr(cdctl_dev_t *dev)
                 cdctl_reg_w_it(dev, CDREG_INT_MASK, CDCTL_MASK | CDBIT_FLAG_TX_BUF_CLEAN);
                 return;
             }
-        } else if (dev->tx_head.first) {
-            dev->tx_frame = cd_list_get(&dev->tx_head);
+        } else if (cd_tx_len(&dev->tx_head)) {
+            dev->tx_frame = cd_tx_get(&dev->tx_head);
+            cd_cap_dev_frame(CD_CAP_TX, dev->cap_id, dev->tx_frame->dat);
             uint8_t *buf = dev->tx_frame->dat - 1;
             *buf = CDREG_TX | 0x80; // borrow space from the "node" item
             dev->state = CDCTL_TX_FRAME;
@@ -285,6 +299,7 @@ void cdctl_spi_isr(cdctl_dev_t *dev)
         dev->state = CDCTL_RX_BODY;
         if (dev->rx_frame->dat[2] > min(CD_FRAME_SIZE - 3, 253)) {
             gpio_set_high(dev->spi->ns_pin);
+            cd_cap_dev_frame(CD_CAP_RX | CD_CAP_ERR, dev->cap_id, dev->rx_frame->dat);
             dev->rx_len_err_cnt++;
             dev->state = CDCTL_REG_W;
             cdctl_reg_w_it(dev, CDREG_RX_CTRL, CDBIT_RX_CLR_PENDING | CDBIT_RX_RST_POINTER);
@@ -302,7 +317,9 @@ void cdctl_spi_isr(cdctl_dev_t *dev)
         dev->state = CDCTL_REG_W;
         cdctl_reg_w_it(dev, CDREG_RX_CTRL, CDBIT_RX_CLR_PENDING | CDBIT_RX_RST_POINTER);
         cd_frame_t *frame = cd_list_get(dev->free_head);
+        cd_cap_dev_frame(CD_CAP_RX, dev->cap_id, dev->rx_frame->dat);
         if (frame) {
+            cd_trace_pt(CD_TRACE_DEV_RX, 0, dev->rx_frame);
             cd_list_put(&dev->rx_head, dev->rx_frame);
             dev->rx_cnt++;
             cdctl_rx_cb(dev, dev->rx_frame);
@@ -317,7 +334,7 @@ void cdctl_spi_isr(cdctl_dev_t *dev)
     if (dev->state == CDCTL_TX_FRAME) {
         gpio_set_high(dev->spi->ns_pin);
 #ifndef CDCTL_TX_NOT_FREE
-        cd_list_put(dev->free_head, dev->tx_frame);
+        cd_frame_free(dev->free_head, dev->tx_frame);
 #endif
         dev->tx_wait_trigger = dev->tx_frame;
         dev->tx_frame = NULL;
@@ -34,12 +34,15 @@ typedef struct {
     cd_dev_t                cd_dev;
     const char              *name;
     uint32_t                sysclk;
+#ifdef CD_CAPTURE_DEV
+    uint8_t                 cap_id; // capture interface id
+#endif
 
     volatile cdctl_state_t  state;
 
     list_head_t             *free_head;
     list_head_t             rx_head;
-    list_head_t             tx_head;
+    cd_tx_head_t            tx_head;
 
     cd_frame_t              *rx_frame;
     cd_frame_t              *tx_frame;
@@ -97,6 +100,7 @@ void cdctl_get_baud_rate(cdctl_dev_t *dev, uint32_t *low, uint32_t *high);
 
 cd_frame_t *cdctl_recv_frame(cd_dev_t *cd_dev);
 void cdctl_send_frame(cd_dev_t *cd_dev, cd_frame_t *frame);
+void cdctl_send_frames(cd_dev_t *cd_dev, list_head_t *frames);
 
 static inline void cdctl_flush(cdctl_dev_t *dev)
 {
@@ -35,6 +35,9 @@ int cdn_hdr_size_frm(const cd_frame_t *frm)
 
     if ((hdr & 0x80) == 0)          // level 0
         return 2;
+#ifdef CDN_L1_TABLE
+    return cdn1_hdr_tbl[hdr & 0x3f].size;
+#else
 
     int hdr_size = 3;
     if (hdr & 0x20)
@@ -47,4 +50,23 @@ int cdn_hdr_size_frm(const cd_frame_t *frm)
     if (hdr & 1)
         hdr_size ++;
     return hdr_size;
+#endif
+}
+
+
+// parse rx frames in one pass (e.g. a gateway draining a device), pkts: frm and _l_net set,
+// the next frame header is fetched while the current one is decoded,
+// errs: 0 or cdn_frm_err_t for each frame, return the number of bad frames
+int cdn_frame_r_batch(cdn_pkt_t **pkts, int num, int8_t *errs)
+{
+    int err_cnt = 0;
+
+    for (int i = 0; i < num; i++) {
+        if (i + 1 < num)
+            __builtin_prefetch(pkts[i + 1]->frm->dat);
+        errs[i] = cdn_frame_r(pkts[i]);
+        if (errs[i])
+            err_cnt++;
+    }
+    return err_cnt;
 }
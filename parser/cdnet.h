@@ -26,6 +26,10 @@ extern "C" {
 #error "This library currently only supports little-endian"
 #endif
 
+// table driven level 1 header codec: a few loads instead of the flag branches,
+// for hosts and gateways with mixed header types (the table takes 448 bytes)
+//#define CDN_L1_TABLE
+
 typedef enum {
     CDN_MULTI_NONE = 0,
     CDN_MULTI_CAST,
@@ -41,10 +45,19 @@ typedef struct {
 
 
 #define CDN_CONF_NOT_FREE   (1 << 0) // not free packet after transmit
+#define CDN_CONF_PRIO(n)    ((n) << 4) // tx priority: 0 ~ 3, see CD_TX_PRIO_NUM
+#define CDN_CONF_PRIO_MSK   (3 << 4)
 
 #define CDN_RET_FMT_ERR     (1 << 1)
 #define CDN_RET_ROUTE_ERR   (1 << 2)
 
+// cdn_frame_r errors, the frame length is validated while decoding
+typedef enum {
+    CDN_FRM_ERR_HDR = -2,   // invalid header flags or level 0 dst port
+    CDN_FRM_ERR_LEN = -3,   // header longer than dat[2]
+    CDN_FRM_ERR_SIZE = -4   // dat[2] exceeds the frame buffer
+} cdn_frm_err_t;
+
 typedef struct {
     list_node_t     node;
     uint8_t         _s_mac;
@@ -65,9 +78,26 @@ typedef struct {
 #ifdef CDN_IRQ_SAFE
 #define cdn_list_get(head)               list_get_entry_it(head, cdn_pkt_t)
 #define cdn_list_put(head, frm)          list_put_it(head, &(frm)->node)
+#define cdn_list_get_list(head, dst, max) list_get_list_it(head, dst, max)
 #elif !defined(CDN_USER_LIST)
 #define cdn_list_get(head)               list_get_entry(head, cdn_pkt_t)
 #define cdn_list_put(head, frm)          list_put(head, &(frm)->node)
+#define cdn_list_get_list(head, dst, max) list_get_list(head, dst, max)
+#endif
+
+#ifdef CDN_L1_TABLE
+// level 1 header layout, indexed by hdr & 0x3f (bit 3 must be 0, bit 2 is ignored)
+typedef struct {
+    uint8_t         size;   // header size
+    uint8_t         s_addr; // offset of src [net, mac], 0: local
+    uint8_t         d_addr; // offset of dst [net, mac] or [mh, ml], 0: local
+    uint8_t         s_port;
+    uint8_t         d_port;
+    uint8_t         s_type; // src.addr[0]
+    uint8_t         d_type; // dst.addr[0]
+} cdn1_hdr_ent_t;
+
+extern const cdn1_hdr_ent_t cdn1_hdr_tbl[64];
 #endif
 
 int cdn_hdr_size_pkt(const cdn_pkt_t *pkt);
@@ -82,6 +112,7 @@ int cdn0_frame_w(cdn_pkt_t *pkt);
 int cdn0_frame_r(cdn_pkt_t *pkt);
 int cdn1_frame_w(cdn_pkt_t *pkt);
 int cdn1_frame_r(cdn_pkt_t *pkt);
+int cdn_frame_r_batch(cdn_pkt_t **pkts, int num, int8_t *errs);
 
 static inline void cdn_set_addr(uint8_t *addr, uint8_t a0, uint8_t a1, uint8_t a2)
 {
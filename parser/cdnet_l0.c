@@ -57,15 +57,21 @@ int cdn0_hdr_r(cdn_pkt_t *pkt, const uint8_t *hdr)
     return 2;
 }
 
-// addition in: _l_net
+// addition in: _l_net, return cdn_frm_err_t on error
 int cdn0_frame_r(cdn_pkt_t *pkt)
 {
     uint8_t *frame = pkt->frm->dat;
+    if (frame[2] + 3 > cd_frame_size(pkt->frm))
+        return CDN_FRM_ERR_SIZE;
+    if (frame[4] & 0x80)
+        return CDN_FRM_ERR_HDR;
     pkt->_s_mac = frame[0];
     pkt->_d_mac = frame[1];
-    int len = cdn0_hdr_r(pkt, frame + 3);
+    int len = cdn0_hdr_r(pkt, frame + 3); // the max header is always in the buffer
     if (len < 0)
         return len;
+    if (len > frame[2])
+        return CDN_FRM_ERR_LEN;
     pkt->dat = frame + 3 + len;
     pkt->len = frame[2] - len;
     return 0;
@@ -11,6 +11,56 @@
 #include "cdnet.h"
 
 
+#ifdef CDN_L1_TABLE
+
+#define _M(i)           (((i) >> 4) & 3) // cdn_multi_t
+#define _ADDR_LEN(i)    ((_M(i) & CDN_MULTI_NET) ? 4 : (_M(i) ? 2 : 0))
+#define _S_PORT(i)      (1 + _ADDR_LEN(i))
+#define _D_PORT(i)      (_S_PORT(i) + 1 + (((i) >> 1) & 1))
+
+#define _ENT(i) {                                                   \
+    .size = _D_PORT(i) + 1 + ((i) & 1),                             \
+    .s_addr = (_M(i) & CDN_MULTI_NET) ? 1 : 0,                      \
+    .d_addr = (_M(i) & CDN_MULTI_NET) ? 3 : (_M(i) ? 1 : 0),        \
+    .s_port = _S_PORT(i),                                           \
+    .d_port = _D_PORT(i),                                           \
+    .s_type = (_M(i) & CDN_MULTI_NET) ? 0xa0 : 0x80,                \
+    .d_type = (_M(i) & CDN_MULTI_CAST) ? 0xf0 : (_M(i) ? 0xa0 : 0x80) \
+}
+#define _ENT4(i)    _ENT(i), _ENT(i + 1), _ENT(i + 2), _ENT(i + 3)
+#define _ENT16(i)   _ENT4(i), _ENT4(i + 4), _ENT4(i + 8), _ENT4(i + 12)
+
+const cdn1_hdr_ent_t cdn1_hdr_tbl[64] = {
+    _ENT16(0), _ENT16(16), _ENT16(32), _ENT16(48)
+};
+
+
+int cdn1_hdr_w(const cdn_pkt_t *pkt, uint8_t *hdr)
+{
+    const cdn_sockaddr_t *src = &pkt->src;
+    const cdn_sockaddr_t *dst = &pkt->dst;
+    uint8_t idx = (src->addr[0] == 0xa0 ? CDN_MULTI_NET << 4 : 0) |
+            (dst->addr[0] == 0xf0 ? CDN_MULTI_CAST << 4 : 0) |
+            (src->port > 0xff ? 2 : 0) | (dst->port > 0xff ? 1 : 0);
+    const cdn1_hdr_ent_t *e = &cdn1_hdr_tbl[idx];
+
+    // fields not present (offset 0, or the narrow src port high byte) are written in front of
+    // the next field, and overwritten by it or by the flag byte
+    hdr[e->s_addr] = src->addr[1];
+    hdr[e->s_addr + 1] = src->addr[2];
+    hdr[e->d_addr] = dst->addr[1];
+    hdr[e->d_addr + 1] = dst->addr[2];
+    hdr[e->s_port] = src->port & 0xff;
+    hdr[e->s_port + 1] = src->port >> 8;
+    hdr[e->d_port] = dst->port & 0xff;
+    if (idx & 1)
+        hdr[e->d_port + 1] = dst->port >> 8;
+    *hdr = 0x80 | idx;
+    return e->size;
+}
+
+#else
+
 int cdn1_hdr_w(const cdn_pkt_t *pkt, uint8_t *hdr)
 {
     const cdn_sockaddr_t *src = &pkt->src;
@@ -49,6 +99,8 @@ int cdn1_hdr_w(const cdn_pkt_t *pkt, uint8_t *hdr)
     return buf - hdr;
 }
 
+#endif
+
 // addition in: _s_mac, _d_mac
 int cdn1_frame_w(cdn_pkt_t *pkt)
 {
@@ -63,6 +115,31 @@ int cdn1_frame_w(cdn_pkt_t *pkt)
 }
 
 
+#ifdef CDN_L1_TABLE
+
+int cdn1_hdr_r(cdn_pkt_t *pkt, const uint8_t *hdr)
+{
+    uint8_t h = *hdr;
+    cdn_assert((h & 0xc8) == 0x80);
+    const cdn1_hdr_ent_t e = cdn1_hdr_tbl[h & 0x3f]; // copy, the stores to pkt may alias hdr
+
+    // select with cmov rather than branches, the local addresses sit in place of absent fields
+    const uint8_t loc[4] = { pkt->_l_net, pkt->_s_mac, pkt->_l_net, pkt->_d_mac };
+    const uint8_t *sa = e.s_addr ? hdr + e.s_addr : loc;
+    const uint8_t *da = e.d_addr ? hdr + e.d_addr : loc + 2;
+    uint8_t sa1 = sa[0], sa2 = sa[1], da1 = da[0], da2 = da[1];
+    uint16_t s_port = hdr[e.s_port] | (hdr[e.s_port + ((h >> 1) & 1)] & -((h >> 1) & 1)) << 8;
+    uint16_t d_port = hdr[e.d_port] | (hdr[e.d_port + (h & 1)] & -(h & 1)) << 8;
+
+    cdn_set_addr(pkt->src.addr, e.s_type, sa1, sa2);
+    cdn_set_addr(pkt->dst.addr, e.d_type, da1, da2);
+    pkt->src.port = s_port;
+    pkt->dst.port = d_port;
+    return e.size;
+}
+
+#else
+
 int cdn1_hdr_r(cdn_pkt_t *pkt, const uint8_t *hdr)
 {
     cdn_sockaddr_t *src = &pkt->src;
@@ -102,15 +179,23 @@ int cdn1_hdr_r(cdn_pkt_t *pkt, const uint8_t *hdr)
     return buf - hdr;
 }
 
-// addition in: _l_net
+#endif
+
+// addition in: _l_net, return cdn_frm_err_t on error
 int cdn1_frame_r(cdn_pkt_t *pkt)
 {
     uint8_t *frame = pkt->frm->dat;
+    if (frame[2] + 3 > cd_frame_size(pkt->frm))
+        return CDN_FRM_ERR_SIZE;
+    if ((frame[3] & 0xc8) != 0x80)
+        return CDN_FRM_ERR_HDR;
     pkt->_s_mac = frame[0];
     pkt->_d_mac = frame[1];
-    int len = cdn1_hdr_r(pkt, frame + 3);
+    int len = cdn1_hdr_r(pkt, frame + 3); // the max header is always in the buffer
     if (len < 0)
         return len;
+    if (len > frame[2])
+        return CDN_FRM_ERR_LEN;
     pkt->dat = frame + 3 + len;
     pkt->len = frame[2] - len;
     return 0;
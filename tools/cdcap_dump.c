@@ -0,0 +1,112 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+// print a pcapng file written by cd_cap_flush() with decoded cdnet socket addresses
+//
+// build: gcc -Iutils -Iparser -Idev -Iarch/pc tools/cdcap_dump.c parser/*.c -o cdcap_dump
+// usage: cdcap_dump [-x] [file.pcapng], default: stdin, -x: hex dump of the payload
+
+#include "cdbus.h"
+#include "cdnet.h"
+
+static bool swapped;
+static bool hex_out;
+
+static uint32_t rd32(const uint8_t *p)
+{
+    uint32_t val;
+    memcpy(&val, p, 4);
+    return swapped ? __builtin_bswap32(val) : val;
+}
+
+static const char *addr_str(char *buf, const cdn_sockaddr_t *addr)
+{
+    sprintf(buf, "%02x:%02x:%02x:%x", addr->addr[0], addr->addr[1], addr->addr[2], addr->port);
+    return buf;
+}
+
+static void print_epb(const uint8_t *blk, uint32_t blk_len)
+{
+    uint32_t if_id = rd32(blk + 8);
+    uint64_t t = (uint64_t)rd32(blk + 12) << 32 | rd32(blk + 16);
+    uint32_t cap_len = rd32(blk + 20);
+    uint32_t orig_len = rd32(blk + 24);
+    const uint8_t *dat = blk + 28;
+
+    if (cap_len < 4 || 28 + cap_len > blk_len) {
+        printf("bad record\n");
+        return;
+    }
+    uint8_t point = dat[0];
+    printf("%" PRIu64 ".%06" PRIu64 " if%" PRIu32 " %s %s%s ", t / 1000000, t % 1000000, if_id,
+            (point & CD_CAP_DEV) ? "dev" : "cdn", (point & CD_CAP_TX) ? "tx" : "rx",
+            (point & CD_CAP_ERR) ? " err" : "");
+
+    cd_frame_t frm = { 0 };
+    cdn_pkt_t pkt = { 0 };
+    memcpy(frm.dat, dat + 1, min(cap_len - 1, sizeof(frm.dat)));
+    pkt.frm = &frm;
+    printf("[%02x -> %02x] ", frm.dat[0], frm.dat[1]);
+
+    if (point & CD_CAP_ERR) {
+        printf("len %d, dropped by the driver\n", frm.dat[2]);
+        return;
+    }
+    int ret = cdn_frame_r(&pkt);
+    if (ret) {
+        printf("len %d, frame err: %d\n", frm.dat[2], ret);
+        return;
+    }
+    char s_buf[20], d_buf[20];
+    int cap_dat = min((int)pkt.len, (int)(cap_len - 1) - (int)(pkt.dat - frm.dat));
+    printf("%s -> %s len %d%s\n", addr_str(s_buf, &pkt.src), addr_str(d_buf, &pkt.dst), pkt.len,
+            orig_len > cap_len ? " (snap)" : "");
+    if (hex_out && cap_dat > 0) {
+        for (int i = 0; i < cap_dat; i++)
+            printf(i % 16 == 15 || i == cap_dat - 1 ? "%02x\n" : "%02x ", pkt.dat[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *fp = stdin;
+    static uint8_t blk[0x10000];
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-x")) {
+            hex_out = true;
+        } else if (!(fp = fopen(argv[i], "rb"))) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    while (fread(blk, 1, 8, fp) == 8) {
+        if (rd32(blk) == 0x0a0d0d0a) { // section header: byte order of this section
+            if (fread(blk + 8, 1, 4, fp) != 4)
+                break;
+            uint32_t magic;
+            memcpy(&magic, blk + 8, 4);
+            swapped = magic != 0x1a2b3c4d;
+            uint32_t blk_len = rd32(blk + 4);
+            if (blk_len < 12 || blk_len > sizeof(blk) || fread(blk + 12, 1, blk_len - 12, fp) != blk_len - 12)
+                break;
+            continue;
+        }
+        uint32_t type = rd32(blk);
+        uint32_t blk_len = rd32(blk + 4);
+        if (blk_len < 12 || blk_len > sizeof(blk) || fread(blk + 8, 1, blk_len - 8, fp) != blk_len - 8) {
+            fprintf(stderr, "truncated block\n");
+            break;
+        }
+        if (type == 6 && blk_len >= 32)
+            print_epb(blk, blk_len);
+    }
+    return 0;
+}
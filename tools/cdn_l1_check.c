@@ -0,0 +1,122 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+// check the CDN_L1_TABLE level 1 codec against the branchy one, both built from parser/cdnet_l1.c
+//
+// build: gcc -Iutils -Iparser -Idev -Iarch/pc tools/cdn_l1_check.c -o cdn_l1_check
+// usage: cdn_l1_check, return 0 if both codecs are equal
+//
+// decode: every flag byte, every dat[2], with random header bytes and local addresses
+// encode: every src / dst type and port width combination, then decoded back
+
+#define CDN_L1_TABLE
+#include "cdnet_l1.c"
+#undef CDN_L1_TABLE
+
+#define cdn1_hdr_w      ref_hdr_w
+#define cdn1_hdr_r      ref_hdr_r
+#define cdn1_frame_w    ref_frame_w
+#define cdn1_frame_r    ref_frame_r
+#include "cdnet_l1.c"
+#undef cdn1_hdr_w
+#undef cdn1_hdr_r
+#undef cdn1_frame_w
+#undef cdn1_frame_r
+
+#define RAND_CNT    64  // random header bytes per flag byte and length
+
+static int err_cnt;
+
+
+static bool pkt_equal(const cdn_pkt_t *a, const cdn_pkt_t *b)
+{
+    return a->_s_mac == b->_s_mac && a->_d_mac == b->_d_mac &&
+            !memcmp(a->src.addr, b->src.addr, 3) && a->src.port == b->src.port &&
+            !memcmp(a->dst.addr, b->dst.addr, 3) && a->dst.port == b->dst.port &&
+            a->dat == b->dat && a->len == b->len;
+}
+
+static void check_r(cd_frame_t *frm)
+{
+    cdn_pkt_t a = { .frm = frm, ._l_net = rand() };
+    cdn_pkt_t b = a;
+    int ret_a = cdn1_frame_r(&a);
+    int ret_b = ref_frame_r(&b);
+
+    if (ret_a != ret_b || (!ret_a && !pkt_equal(&a, &b))) {
+        if (err_cnt++ < 10)
+            printf("decode mismatch: hdr %02x, len %d, ret %d / %d\n", frm->dat[3], frm->dat[2], ret_a, ret_b);
+    }
+}
+
+static void check_w(const cdn_pkt_t *pkt)
+{
+    cd_frame_t frm_a = { 0 }, frm_b = { 0 };
+    cdn_pkt_t a = *pkt, b = *pkt;
+    a.frm = &frm_a;
+    b.frm = &frm_b;
+    int ret_a = cdn1_frame_w(&a);
+    int ret_b = ref_frame_w(&b);
+
+    if (ret_a != ret_b || memcmp(frm_a.dat, frm_b.dat, 3 + frm_b.dat[2] - pkt->len)) {
+        if (err_cnt++ < 10)
+            printf("encode mismatch: src %02x:%x, dst %02x:%x\n",
+                    pkt->src.addr[0], pkt->src.port, pkt->dst.addr[0], pkt->dst.port);
+        return;
+    }
+
+    check_r(&frm_a); // decode back with both
+}
+
+
+int main(void)
+{
+    static const uint8_t types[] = { 0x80, 0xa0, 0xf0 };
+    static const uint16_t ports[] = { 0x00, 0x01, 0xff, 0x100, 0xcdef, 0xffff };
+    cd_frame_t frm;
+    int cnt = 0;
+
+    srand(1);
+    for (int h = 0; h < 0x100; h++) {
+        for (int len = 0; len < 0x100; len++) {
+            for (int n = 0; n < RAND_CNT; n++) {
+                for (int i = 0; i < 3 + 9; i++) // mac, len and the max header
+                    frm.dat[i] = rand();
+                frm.dat[2] = len;
+                frm.dat[3] = h;
+                check_r(&frm);
+                cnt++;
+            }
+        }
+    }
+    printf("decode: %d frames\n", cnt);
+
+    cnt = 0;
+    for (unsigned st = 0; st < sizeof(types); st++) {
+        for (unsigned dt = 0; dt < sizeof(types); dt++) {
+            for (unsigned sp = 0; sp < sizeof(ports) / sizeof(ports[0]); sp++) {
+                for (unsigned dp = 0; dp < sizeof(ports) / sizeof(ports[0]); dp++) {
+                    for (int n = 0; n < RAND_CNT; n++) {
+                        cdn_pkt_t pkt = { ._s_mac = rand(), ._d_mac = rand(), ._l_net = rand(), .len = rand() % 16 };
+                        cdn_set_addr(pkt.src.addr, types[st] == 0xf0 ? 0x80 : types[st], rand(), rand());
+                        cdn_set_addr(pkt.dst.addr, types[dt], rand(), rand());
+                        pkt.src.port = ports[sp];
+                        pkt.dst.port = ports[dp];
+                        check_w(&pkt);
+                        cnt++;
+                    }
+                }
+            }
+        }
+    }
+    printf("encode: %d headers\n", cnt);
+
+    printf("%d mismatches, %s\n", err_cnt, err_cnt ? "FAILED" : "passed");
+    return !!err_cnt;
+}
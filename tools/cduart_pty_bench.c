@@ -0,0 +1,207 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+// test and benchmark of the linux tty backend over pty pairs, no hardware required
+//
+// build: gcc -O2 -DSYSTICK_US_DIV=1000 -Iutils -Idev -Iarch/pc tools/cduart_pty_bench.c arch/pc/*.c
+//          dev/cdbus_uart.c utils/cd_list.c utils/modbus_crc.c -lutil -o cduart_pty_bench
+// usage: cduart_pty_bench, return 0 if all checks passed
+//
+// checks: every frame length over the pair, port removal after the other side is closed
+// bench: round trip latency of a single frame, and throughput with 64 frames in flight
+
+#include <pty.h>
+#include <time.h>
+#include <unistd.h>
+#include "cduart_linux.h"
+
+#define FRAME_MAX   400
+
+static list_head_t free_head;
+static cd_frame_t frames[FRAME_MAX];
+static cduart_dev_t dev_a = { .name = "a" };
+static cduart_dev_t dev_b = { .name = "b" };
+static cduart_lx_port_t ports[2];
+static cduart_lx_t lx;
+
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static cd_frame_t *frame_new(int len)
+{
+    cd_frame_t *frm = cd_list_get(&free_head);
+    if (frm) {
+        frm->dat[0] = 0x01;
+        frm->dat[1] = 0x02;
+        frm->dat[2] = len;
+        for (int i = 0; i < len; i++)
+            frm->dat[3 + i] = i ^ len;
+    }
+    return frm;
+}
+
+static cd_frame_t *frame_wait(cduart_dev_t *dev)
+{
+    cd_frame_t *frm;
+    double t = now();
+    while (!(frm = cd_list_get(&dev->rx_head))) {
+        if (now() - t > 1) // lost
+            return NULL;
+        cduart_lx_poll(&lx, 10);
+    }
+    return frm;
+}
+
+static int check_lengths(void)
+{
+    int err = 0;
+
+    for (int len = 0; len <= CD_FRAME_SIZE - 5; len++) {
+        cd_tx_put(&dev_a.tx_head, frame_new(len));
+        cd_frame_t *frm = frame_wait(&dev_b);
+        if (!frm) {
+            err++;
+            continue;
+        }
+        if (frm->dat[0] != 0x01 || frm->dat[1] != 0x02 || frm->dat[2] != len) {
+            err++;
+        } else {
+            for (int i = 0; i < len; i++) {
+                if (frm->dat[3 + i] != (uint8_t)(i ^ len)) {
+                    err++;
+                    break;
+                }
+            }
+        }
+        cd_list_put(&free_head, frm);
+    }
+    printf("lengths 0 ~ %d: %d errors\n", CD_FRAME_SIZE - 5, err);
+    return err;
+}
+
+static void bench(int len)
+{
+    static double lat[2000];
+    int cnt = sizeof(lat) / sizeof(lat[0]);
+
+    for (int i = 0; i < cnt; i++) {
+        double t = now();
+        cd_tx_put(&dev_a.tx_head, frame_new(len));
+        cd_frame_t *frm = frame_wait(&dev_b);
+        lat[i] = now() - t;
+        if (frm)
+            cd_list_put(&free_head, frm);
+    }
+    qsort(lat, cnt, sizeof(double), cmp_double);
+
+    int n = 800000 / (len + 8);
+    int sent = 0, recv = 0;
+    double t = now();
+    while (recv < n && now() - t < 10) {
+        while (sent < n && sent - recv < 64) {
+            cd_frame_t *frm = frame_new(len);
+            if (!frm)
+                break;
+            cd_tx_put(&dev_a.tx_head, frm);
+            sent++;
+        }
+        cduart_lx_poll(&lx, 10);
+        cd_frame_t *frm;
+        while ((frm = cd_list_get(&dev_b.rx_head)) != NULL) {
+            recv++;
+            cd_list_put(&free_head, frm);
+        }
+    }
+    t = now() - t;
+    printf("len %3d: latency p50 %.1f us, p99 %.1f us, max %.1f us | %.0f frames/s, %.2f MB/s\n", len,
+            lat[cnt / 2] * 1e6, lat[cnt * 99 / 100] * 1e6, lat[cnt - 1] * 1e6, recv / t, recv * (len + 5) / t / 1e6);
+}
+
+// close the other side of a pty, the port must be removed and its tx frames freed
+static int check_removal(void)
+{
+    cduart_dev_t dev_c = { .name = "c" };
+    cduart_lx_port_t port_c = { .dev = &dev_c };
+    cduart_lx_t lx_c;
+    int m, s;
+
+    if (openpty(&m, &s, NULL, NULL, NULL)) {
+        perror("openpty");
+        return 1;
+    }
+    cduart_dev_init(&dev_c, &free_head);
+    uint32_t free_len = free_head.len;
+    port_c.fd = m;
+    if (cduart_lx_init(&lx_c, &port_c, 1)) {
+        close(m);
+        close(s);
+        return 1;
+    }
+
+    close(s);
+    for (int i = 0; i < 10 && !port_c.dead; i++)
+        cduart_lx_poll(&lx_c, 10);
+    for (int i = 0; i < 16; i++)
+        cd_tx_put(&dev_c.tx_head, frame_new(i));
+    cduart_lx_poll(&lx_c, 0);
+
+    int err = !port_c.dead || cd_tx_len(&dev_c.tx_head) || free_head.len != free_len;
+    printf("removal: dead %d, dropped %u, free frames %u/%u\n",
+            port_c.dead, port_c.drop_cnt, free_head.len, free_len);
+    cduart_lx_deinit(&lx_c);
+    close(m);
+    return err;
+}
+
+
+int main(void)
+{
+    int m, s, err = 0;
+
+    for (int i = 0; i < FRAME_MAX; i++)
+        cd_list_put(&free_head, &frames[i]);
+    cduart_dev_init(&dev_a, &free_head);
+    cduart_dev_init(&dev_b, &free_head);
+
+    if (openpty(&m, &s, NULL, NULL, NULL)) {
+        perror("openpty");
+        return 1;
+    }
+    ports[0] = (cduart_lx_port_t) { .dev = &dev_a, .fd = m };
+    ports[1] = (cduart_lx_port_t) { .dev = &dev_b, .fd = s };
+    if (cduart_lx_init(&lx, ports, 2)) {
+        printf("init failed\n");
+        return 1;
+    }
+
+    err += check_lengths();
+    bench(8);
+    bench(64);
+    bench(CD_FRAME_SIZE - 5);
+    printf("a: tx %u bytes, %u frames, b: rx %u bytes, errors %u %u\n", ports[0].tx_bytes,
+            ports[0].tx_frames, ports[1].rx_bytes, ports[0].err_cnt, ports[1].err_cnt);
+    cduart_lx_deinit(&lx);
+    close(m);
+    close(s);
+
+    err += check_removal();
+    printf("%s\n", err ? "FAILED" : "passed");
+    return !!err;
+}
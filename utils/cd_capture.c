@@ -0,0 +1,146 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cd_capture.h"
+
+cd_cap_t *cd_cap = NULL;
+
+
+// frame: cd_frame_t dat, the bytes after the header of a CD_CAP_ERR frame may be stale
+void cd_cap_put(cd_cap_t *cap, uint8_t point, uint8_t id, const uint8_t *frame)
+{
+    uint32_t idx = __atomic_load_n(&cap->wr, __ATOMIC_RELAXED);
+
+    // lock-free reservation, safe from irqs and other cores
+    do {
+        // signed: idx may be older than rd, then the cas fails and reloads it
+        if ((int32_t)(idx - __atomic_load_n(&cap->rd, __ATOMIC_ACQUIRE)) >= (int32_t)cap->num) {
+            __atomic_fetch_add(&cap->drop_cnt, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&cap->wr, &idx, idx + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    // the flush stops at the first record not done
+    cd_cap_rec_t *rec = &cap->recs[idx & (cap->num - 1)];
+    rec->point = point;
+    rec->id = id;
+    rec->len = frame[2] + 3;
+    rec->cap_len = min(rec->len, CD_CAP_SNAP);
+    rec->time = get_systick();
+    memcpy(rec->dat, frame, rec->cap_len);
+    __atomic_store_n(&rec->done, 1, __ATOMIC_RELEASE);
+}
+
+
+static inline uint8_t *cd_cap_w32(uint8_t *p, uint32_t val)
+{
+    memcpy(p, &val, 4); // host byte order, pcapng readers follow the section magic
+    return p + 4;
+}
+
+static int cd_cap_write_hdr(cd_cap_t *cap)
+{
+    uint8_t buf[28];
+    uint8_t *p = buf;
+
+    // section header block
+    p = cd_cap_w32(p, 0x0a0d0d0a);
+    p = cd_cap_w32(p, 28);
+    p = cd_cap_w32(p, 0x1a2b3c4d);
+    p = cd_cap_w32(p, 1);           // version 1.0
+    p = cd_cap_w32(p, 0xffffffff);  // section length: unknown
+    p = cd_cap_w32(p, 0xffffffff);
+    cd_cap_w32(p, 28);
+    if (cap->write(cap->arg, buf, 28) < 0)
+        return -1;
+
+    // interface description blocks, timestamp unit: us (default if_tsresol)
+    for (int i = 0; i < CD_CAP_IF_NUM; i++) {
+        p = buf;
+        p = cd_cap_w32(p, 1);
+        p = cd_cap_w32(p, 20);
+        p = cd_cap_w32(p, CD_CAP_LINKTYPE);
+        p = cd_cap_w32(p, CD_CAP_SNAP + 1);
+        cd_cap_w32(p, 20);
+        if (cap->write(cap->arg, buf, 20) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int cd_cap_write_rec(cd_cap_t *cap, const cd_cap_rec_t *rec)
+{
+    uint8_t buf[28 + ((CD_CAP_SNAP + 1 + 3) & ~3) + 16];
+    uint8_t *p = buf;
+    unsigned dat_len = rec->cap_len + 1;
+    unsigned pad_len = (4 - (dat_len & 3)) & 3;
+    unsigned blk_len = 28 + dat_len + pad_len + 16;
+
+    if (rec->time < cap->t_last)
+        cap->t_high++;
+    cap->t_last = rec->time;
+    uint64_t t = (((uint64_t)cap->t_high << 32) | rec->time) * CD_SYSTICK_US_DIV;
+
+    // enhanced packet block
+    p = cd_cap_w32(p, 6);
+    p = cd_cap_w32(p, blk_len);
+    p = cd_cap_w32(p, min(rec->id, CD_CAP_IF_NUM - 1));
+    p = cd_cap_w32(p, t >> 32);
+    p = cd_cap_w32(p, t);
+    p = cd_cap_w32(p, dat_len);
+    p = cd_cap_w32(p, rec->len + 1);
+    *p++ = rec->point;
+    memcpy(p, rec->dat, rec->cap_len);
+    p += rec->cap_len;
+    memset(p, 0, pad_len);
+    p += pad_len;
+
+    // epb_flags: inbound / outbound, opt_endofopt
+    p = cd_cap_w32(p, 2 | (4 << 16));
+    p = cd_cap_w32(p, (rec->point & CD_CAP_TX) ? 2 : 1);
+    p = cd_cap_w32(p, 0);
+    cd_cap_w32(p, blk_len);
+    return cap->write(cap->arg, buf, blk_len);
+}
+
+int cd_cap_flush(cd_cap_t *cap, int max)
+{
+    int cnt = 0;
+
+    if (!cap->hdr_done) {
+        if (cd_cap_write_hdr(cap))
+            return 0;
+        cap->hdr_done = true;
+    }
+
+    while (cnt < max && cap->rd != cap->wr) {
+        cd_cap_rec_t *rec = &cap->recs[cap->rd & (cap->num - 1)];
+        if (!__atomic_load_n(&rec->done, __ATOMIC_ACQUIRE))
+            break; // still being filled
+        if (cd_cap_write_rec(cap, rec) < 0)
+            break;
+        rec->done = 0;
+        __atomic_store_n(&cap->rd, cap->rd + 1, __ATOMIC_RELEASE); // slot free for cd_cap_put
+        cnt++;
+    }
+    return cnt;
+}
+
+
+// num: power of 2, set the hooks target
+void cd_cap_init(cd_cap_t *cap, cd_cap_rec_t *recs, uint32_t num, cd_cap_write_t write, void *arg)
+{
+    memset(cap, 0, sizeof(cd_cap_t));
+    memset(recs, 0, sizeof(cd_cap_rec_t) * num);
+    cap->recs = recs;
+    cap->num = num;
+    cap->write = write;
+    cap->arg = arg;
+    cd_cap = cap;
+}
@@ -0,0 +1,105 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CD_CAPTURE_H__
+#define __CD_CAPTURE_H__
+
+#include "cd_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// frame capture: the hooks copy frames into a ring of fixed size records (lock-free, never block),
+// cd_cap_flush() writes them out as pcapng from a low priority context
+//
+// packet data of each pcapng record: [point], frame: [src_mac, dst_mac, len, ...] (no crc)
+// interface id: cdn intf index for the namespace layer, cap_id of the device for the device layer
+
+// capture at cdn_poll rx and cdn_send_frame tx
+//#define CD_CAPTURE
+// also capture in the device drivers (cduart_rx_handle, cdctl), require CD_CAPTURE
+//#define CD_CAPTURE_DEV
+#if defined(CD_CAPTURE_DEV) && !defined(CD_CAPTURE)
+#error "CD_CAPTURE_DEV requires CD_CAPTURE"
+#endif
+
+#ifndef CD_CAP_SNAP
+#define CD_CAP_SNAP         64      // bytes kept per frame, <= CD_FRAME_SIZE
+#endif
+#ifndef CD_CAP_LINKTYPE
+#define CD_CAP_LINKTYPE     147     // LINKTYPE_USER0
+#endif
+#ifndef CD_CAP_IF_NUM
+#define CD_CAP_IF_NUM       4       // pcapng interfaces, ids above are folded
+#endif
+
+// point
+#define CD_CAP_RX           0x01
+#define CD_CAP_TX           0x02
+#define CD_CAP_ERR          0x04    // dropped by the driver, e.g. crc error
+#define CD_CAP_DEV          0x80    // device layer
+
+typedef struct {
+    volatile uint8_t done;          // set after the record is filled
+    uint8_t         point;
+    uint8_t         id;
+    uint8_t         _reserved;
+    uint16_t        len;            // frame length: dat[2] + 3
+    uint16_t        cap_len;
+    uint32_t        time;           // systick
+    uint8_t         dat[CD_CAP_SNAP];
+} cd_cap_rec_t;
+
+// write all or nothing, return < 0 if nothing written (retry at next flush)
+typedef int (*cd_cap_write_t)(void *arg, const void *dat, int len);
+
+typedef struct {
+    cd_cap_rec_t    *recs;
+    uint32_t        num;            // power of 2
+    volatile uint32_t wr;           // records reserved, by compare and swap
+    volatile uint32_t rd;           // records flushed
+
+    cd_cap_write_t  write;
+    void            *arg;
+    bool            hdr_done;       // pcapng section and interface blocks written
+    uint32_t        t_last;         // extend systick to 64 bits
+    uint32_t        t_high;
+
+    uint32_t        drop_cnt;       // ring full
+} cd_cap_t;
+
+extern cd_cap_t *cd_cap;            // hooks target, NULL: capture off
+
+
+void cd_cap_init(cd_cap_t *cap, cd_cap_rec_t *recs, uint32_t num, cd_cap_write_t write, void *arg);
+void cd_cap_put(cd_cap_t *cap, uint8_t point, uint8_t id, const uint8_t *frame);
+int cd_cap_flush(cd_cap_t *cap, int max); // return records written
+
+#ifdef CD_CAPTURE
+#define cd_cap_frame(point, id, frame)                          \
+    do {                                                        \
+        if (cd_cap)                                             \
+            cd_cap_put(cd_cap, point, id, frame);               \
+    } while (0)
+#else
+#define cd_cap_frame(point, id, frame)      do { } while (0)
+#endif
+
+#ifdef CD_CAPTURE_DEV
+#define cd_cap_dev_frame(point, id, frame)  cd_cap_frame((point) | CD_CAP_DEV, id, frame)
+#else
+#define cd_cap_dev_frame(point, id, frame)  do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -15,6 +15,24 @@
 static void list_check(list_head_t *head);
 #endif
 
+#ifdef CD_LIST_STAT
+// called after each removal, only a NULL check for untracked lists
+static inline void list_stat_update(list_head_t *head, bool empty)
+{
+    list_stat_t *st = head->stat;
+    if (!st)
+        return;
+    if (empty) {
+        st->empty_cnt++;
+        st->t_empty = get_systick();
+    } else if (head->len < st->len_min) {
+        st->len_min = head->len;
+    }
+}
+#else
+#define list_stat_update(head, empty)   do {} while (0)
+#endif
+
 // pick first item
 list_node_t *list_get(list_head_t *head)
 {
@@ -25,6 +43,7 @@ list_node_t *list_get(list_head_t *head)
         if (--head->len == 0)
             head->last = NULL;
     }
+    list_stat_update(head, !node);
 #ifdef CD_LIST_DEBUG
     list_check(head);
 #endif
@@ -50,8 +69,10 @@ list_node_t *list_get_last(list_head_t *head)
     list_node_t *pre = NULL;
     list_node_t *node = head->first;
 
-    if (!node)
+    if (!node) {
+        list_stat_update(head, true);
         return NULL;
+    }
 
     while (node->next) {
         pre = node;
@@ -65,6 +86,7 @@ list_node_t *list_get_last(list_head_t *head)
         head->first = head->last = NULL;
     }
     head->len--;
+    list_stat_update(head, false);
 
 #ifdef CD_LIST_DEBUG
     list_check(head);
@@ -91,6 +113,7 @@ void list_pick(list_head_t *head, list_node_t *pre, list_node_t *node)
         head->first = node->next;
     if (--head->len == 0)
         head->last = NULL;
+    list_stat_update(head, false);
 #ifdef CD_LIST_DEBUG
     list_check(head);
 #endif
@@ -112,6 +135,77 @@ void list_move_begin(list_head_t *head, list_node_t *pre, list_node_t *node)
 #endif
 }
 
+// append all items of src at end, src become empty
+void list_put_list(list_head_t *head, list_head_t *src)
+{
+    if (!src->len)
+        return;
+    if (head->len)
+        head->last->next = src->first;
+    else
+        head->first = src->first;
+    head->last = src->last;
+    head->len += src->len;
+    src->first = src->last = NULL;
+    src->len = 0;
+#ifdef CD_LIST_DEBUG
+    list_check(head);
+#endif
+}
+
+// move up to max items from the beginning of head to the end of dst
+uint32_t list_get_list(list_head_t *head, list_head_t *dst, uint32_t max)
+{
+    uint32_t cnt = min(head->len, max);
+    if (!cnt) {
+        if (max)
+            list_stat_update(head, true);
+        return 0;
+    }
+
+    list_node_t *first = head->first;
+    list_node_t *last = first;
+    for (uint32_t i = 1; i < cnt; i++)
+        last = last->next;
+
+    head->first = last->next;
+    head->len -= cnt;
+    if (!head->len)
+        head->last = NULL;
+    list_stat_update(head, false);
+
+    if (dst->len)
+        dst->last->next = first;
+    else
+        dst->first = first;
+    dst->last = last;
+    dst->len += cnt;
+    last->next = NULL;
+#ifdef CD_LIST_DEBUG
+    list_check(head);
+    list_check(dst);
+#endif
+    return cnt;
+}
+
+
+#ifdef CD_LIST_STAT
+// reset and start tracking, the low watermark starts from the current length
+void list_stat_attach(list_head_t *head, list_stat_t *stat)
+{
+    memset(stat, 0, sizeof(list_stat_t));
+    stat->len_min = head->len;
+    head->stat = stat;
+}
+
+// snapshot of an attached list, use list_stat_get_it for lists shared with irq
+void list_stat_get(list_head_t *head, list_stat_t *out)
+{
+    *out = *head->stat;
+    out->len = head->len;
+}
+#endif
+
 
 #ifdef CD_LIST_DEBUG
 static _Unwind_Reason_Code trace_fcn(_Unwind_Context *ctx, void *_)
@@ -18,11 +18,26 @@ typedef struct list_node {
    struct list_node *next;
 } list_node_t;
 
+// occupancy statistics for lists used as free pools, enabled per list by list_stat_attach()
+//#define CD_LIST_STAT
+
+#ifdef CD_LIST_STAT
+typedef struct {
+    uint32_t        len;        // current length, set by list_stat_get only
+    uint32_t        len_min;    // low watermark since attach
+    uint32_t        empty_cnt;  // get from empty list (exhaustion events)
+    uint32_t        t_empty;    // systick of the last exhaustion
+} list_stat_t;
+#endif
+
 typedef struct {
     list_node_t     *first;
     list_node_t     *last;
     uint32_t        len;
     cd_spinlock_t   lock;
+#ifdef CD_LIST_STAT
+    list_stat_t     *stat;      // NULL: not tracked
+#endif
 } list_head_t;
 
 
@@ -33,6 +48,13 @@ list_node_t *list_get_last(list_head_t *head);
 void list_put_begin(list_head_t *head, list_node_t *node);
 void list_pick(list_head_t *head, list_node_t *pre, list_node_t *node);
 void list_move_begin(list_head_t *head, list_node_t *pre, list_node_t *node);
+void list_put_list(list_head_t *head, list_head_t *src);
+uint32_t list_get_list(list_head_t *head, list_head_t *dst, uint32_t max);
+
+#ifdef CD_LIST_STAT
+void list_stat_attach(list_head_t *head, list_stat_t *stat);
+void list_stat_get(list_head_t *head, list_stat_t *out);
+#endif
 
 
 #define list_entry(ptr, type)                                   \
@@ -109,6 +131,34 @@ static inline void list_put_begin_it(list_head_t *head, list_node_t *node)
     cd_irq_restore(&head->lock, flags);
 }
 
+static inline void list_put_list_it(list_head_t *head, list_head_t *src)
+{
+    uint32_t flags;
+    cd_irq_save(&head->lock, flags);
+    list_put_list(head, src);
+    cd_irq_restore(&head->lock, flags);
+}
+
+static inline uint32_t list_get_list_it(list_head_t *head, list_head_t *dst, uint32_t max)
+{
+    uint32_t flags;
+    uint32_t cnt;
+    cd_irq_save(&head->lock, flags);
+    cnt = list_get_list(head, dst, max);
+    cd_irq_restore(&head->lock, flags);
+    return cnt;
+}
+
+#ifdef CD_LIST_STAT
+static inline void list_stat_get_it(list_head_t *head, list_stat_t *out)
+{
+    uint32_t flags;
+    cd_irq_save(&head->lock, flags);
+    list_stat_get(head, out);
+    cd_irq_restore(&head->lock, flags);
+}
+#endif
+
 #endif // CD_LIST_IT
 
 #ifdef __cplusplus
@@ -0,0 +1,110 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cd_timer.h"
+
+#define CD_TIMER_MASK       (CD_TIMER_SLOTS - 1)
+#define CD_TIMER_RANGE      (1ull << (CD_TIMER_BITS * CD_TIMER_LVL))
+
+
+static inline void cd_timer_link(cd_timer_t **head, cd_timer_t *tm)
+{
+    tm->next = *head;
+    if (tm->next)
+        tm->next->pprev = &tm->next;
+    tm->pprev = head;
+    *head = tm;
+}
+
+static void cd_timer_insert(cd_timer_wheel_t *w, cd_timer_t *tm)
+{
+    uint32_t delta = tm->expire - w->tick;
+    int lvl = 0;
+
+    if ((int32_t)delta < 0) { // already expired, run at next tick
+        tm->expire = w->tick;
+        delta = 0;
+    } else if (delta >= CD_TIMER_RANGE) {
+        tm->expire = w->tick + (uint32_t)(CD_TIMER_RANGE - 1);
+        delta = CD_TIMER_RANGE - 1;
+    }
+
+    while (delta >= CD_TIMER_SLOTS) {
+        delta >>= CD_TIMER_BITS;
+        lvl++;
+    }
+    cd_timer_link(&w->slots[lvl][(tm->expire >> (lvl * CD_TIMER_BITS)) & CD_TIMER_MASK], tm);
+}
+
+// re-arm if pending
+void cd_timer_add(cd_timer_wheel_t *w, cd_timer_t *tm, uint32_t expire)
+{
+    cd_timer_del(tm);
+    tm->expire = expire;
+    cd_timer_insert(w, tm);
+}
+
+void cd_timer_del(cd_timer_t *tm)
+{
+    if (!tm->pprev)
+        return;
+    *tm->pprev = tm->next;
+    if (tm->next)
+        tm->next->pprev = tm->pprev;
+    tm->pprev = NULL;
+}
+
+// move a higher level slot down, return the slot index
+static unsigned cd_timer_cascade(cd_timer_wheel_t *w, int lvl)
+{
+    unsigned idx = (w->tick >> (lvl * CD_TIMER_BITS)) & CD_TIMER_MASK;
+    cd_timer_t *tm = w->slots[lvl][idx];
+    w->slots[lvl][idx] = NULL;
+
+    while (tm) {
+        cd_timer_t *next = tm->next;
+        cd_timer_insert(w, tm);
+        tm = next;
+    }
+    return idx;
+}
+
+void cd_timer_run(cd_timer_wheel_t *w)
+{
+    uint32_t now = get_systick();
+
+    while ((int32_t)(now - w->tick) >= 0) {
+        unsigned idx = w->tick & CD_TIMER_MASK;
+
+        for (int lvl = 1; lvl < CD_TIMER_LVL; lvl++) {
+            if ((w->tick >> ((lvl - 1) * CD_TIMER_BITS)) & CD_TIMER_MASK)
+                break;
+            cd_timer_cascade(w, lvl);
+        }
+
+        // detach, so callbacks can add or delete any timer
+        cd_timer_t *list = w->slots[0][idx];
+        w->slots[0][idx] = NULL;
+        if (list)
+            list->pprev = &list;
+
+        w->tick++;
+        while (list) {
+            cd_timer_t *tm = list;
+            cd_timer_del(tm);
+            tm->cb(tm);
+        }
+    }
+}
+
+void cd_timer_wheel_init(cd_timer_wheel_t *w)
+{
+    memset(w, 0, sizeof(cd_timer_wheel_t));
+    w->tick = get_systick();
+}
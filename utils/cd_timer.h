@@ -0,0 +1,65 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CD_TIMER_H__
+#define __CD_TIMER_H__
+
+#include "cd_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// hierarchical timer wheel driven by get_systick(), not irq safe
+// range: 1 << (CD_TIMER_BITS * CD_TIMER_LVL) systick, longer timeouts are clamped
+
+#ifndef CD_TIMER_BITS
+#define CD_TIMER_BITS       6
+#endif
+#ifndef CD_TIMER_LVL
+#define CD_TIMER_LVL        4
+#endif
+
+#define CD_TIMER_SLOTS      (1 << CD_TIMER_BITS)
+
+typedef struct cd_timer {
+    struct cd_timer *next;
+    struct cd_timer **pprev;    // NULL: not pending
+    uint32_t        expire;     // systick
+    void            (*cb)(struct cd_timer *tm);
+} cd_timer_t;
+
+typedef struct {
+    uint32_t        tick;       // next systick to process
+    cd_timer_t      *slots[CD_TIMER_LVL][CD_TIMER_SLOTS];
+} cd_timer_wheel_t;
+
+
+void cd_timer_wheel_init(cd_timer_wheel_t *w);
+void cd_timer_add(cd_timer_wheel_t *w, cd_timer_t *tm, uint32_t expire);
+void cd_timer_del(cd_timer_t *tm);
+void cd_timer_run(cd_timer_wheel_t *w);
+
+static inline bool cd_timer_pending(const cd_timer_t *tm)
+{
+    return tm->pprev != NULL;
+}
+
+// add relative to now, re-arm if pending
+// +1: now may be at the end of the current systick, wait at least the full timeout
+static inline void cd_timer_mod(cd_timer_wheel_t *w, cd_timer_t *tm, uint32_t timeout)
+{
+    cd_timer_add(w, tm, get_systick() + timeout + 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
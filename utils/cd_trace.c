@@ -0,0 +1,130 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#include "cd_trace.h"
+
+cd_trace_t *cd_trace = NULL;
+
+
+void cd_trace_put(cd_trace_t *tr, uint8_t stage, uint16_t port, const void *frm)
+{
+    __attribute__((unused)) uint32_t flags; // unused if local_irq_save is a no-op
+    uint32_t idx;
+
+    cd_irq_save(&tr->lock, flags);
+    idx = tr->wr++;
+    cd_irq_restore(&tr->lock, flags);
+
+    // the oldest record is overwritten, the reader checks seq before and after the copy
+    cd_trace_rec_t *rec = &tr->recs[idx & (tr->num - 1)];
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    rec->time = CD_TRACE_TIME();
+    rec->id = (uintptr_t)frm;
+    rec->port = port;
+    rec->stage = stage;
+    __atomic_store_n(&rec->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+
+static inline int cd_trace_bkt(uint32_t dt)
+{
+    int n = dt ? 32 - __builtin_clz(dt) : 0;
+    return min(n, CD_TRACE_BKT - 1);
+}
+
+static cd_trace_hist_t *cd_trace_hist(cd_trace_hist_t *hists, int num, int *used, uint16_t port, uint8_t stage)
+{
+    for (int i = 0; i < *used; i++) {
+        if (hists[i].port == port && hists[i].stage == stage)
+            return &hists[i];
+    }
+    if (*used == num)
+        return NULL;
+    cd_trace_hist_t *h = &hists[(*used)++];
+    memset(h, 0, sizeof(cd_trace_hist_t));
+    h->port = port;
+    h->stage = stage;
+    return h;
+}
+
+static void cd_trace_link(cd_trace_t *tr, const cd_trace_rec_t *rec, cd_trace_hist_t *hists, int num, int *used)
+{
+    uint32_t hash = (rec->id >> 2) ^ (rec->id >> 9);
+    typeof(tr->link[0]) *l = &tr->link[hash & (CD_TRACE_LINK - 1)];
+    bool linked = l->id == rec->id && rec->stage != CD_TRACE_DEV_RX && rec->stage != CD_TRACE_TX_Q &&
+            l->stage == rec->stage - 1;
+    uint16_t port = rec->port ? rec->port : (linked ? l->port : 0);
+
+    if (linked) {
+        cd_trace_hist_t *h = cd_trace_hist(hists, num, used, port, rec->stage);
+        if (h) {
+            uint32_t dt = rec->time - l->time;
+            h->cnt++;
+            h->max = max(h->max, dt);
+            h->bkt[cd_trace_bkt(dt)]++;
+        }
+    }
+    l->id = rec->id;
+    l->time = rec->time;
+    l->port = port;
+    l->stage = rec->stage;
+}
+
+// consume the new records into hists (reset by the caller by used = 0)
+int cd_trace_aggr(cd_trace_t *tr, cd_trace_hist_t *hists, int num, int used)
+{
+    uint32_t wr = tr->wr;
+
+    if (wr - tr->rd > tr->num) {
+        tr->lost_cnt += wr - tr->rd - tr->num;
+        tr->rd = wr - tr->num;
+    }
+    while (tr->rd != wr) {
+        cd_trace_rec_t *rec = &tr->recs[tr->rd & (tr->num - 1)];
+        cd_trace_rec_t r;
+        uint32_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        if (seq == 0 || (int32_t)(seq - (tr->rd + 1)) < 0)
+            break; // still being written
+        r = *rec;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq != tr->rd + 1 || rec->seq != seq) {
+            tr->lost_cnt++; // overwritten
+        } else {
+            cd_trace_link(tr, &r, hists, num, &used);
+        }
+        tr->rd++;
+    }
+    return used;
+}
+
+// pct: 0 ~ 100, e.g. 50, 99
+uint32_t cd_trace_pct(const cd_trace_hist_t *hist, unsigned pct)
+{
+    uint32_t target = ((uint64_t)hist->cnt * pct + 99) / 100;
+    uint32_t sum = 0;
+
+    for (int i = 0; i < CD_TRACE_BKT; i++) {
+        sum += hist->bkt[i];
+        if (sum >= target && sum)
+            return min(i ? (1u << i) - 1 : 0, hist->max);
+    }
+    return hist->max;
+}
+
+
+// num: power of 2, enable the trace points
+void cd_trace_init(cd_trace_t *tr, cd_trace_rec_t *recs, uint32_t num)
+{
+    memset(tr, 0, sizeof(cd_trace_t));
+    memset(recs, 0, sizeof(cd_trace_rec_t) * num);
+    tr->recs = recs;
+    tr->num = num;
+    cd_trace = tr;
+}
@@ -0,0 +1,98 @@
+/*
+ * Software License Agreement (MIT License)
+ *
+ * Copyright (c) 2017, DUKELEC, Inc.
+ * All rights reserved.
+ *
+ * Author: Duke Fong <d@d-l.io>
+ */
+
+#ifndef __CD_TRACE_H__
+#define __CD_TRACE_H__
+
+#include "cd_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// hot path trace points: fixed size records (stage, port, frame, time) in an overwrite ring,
+// cd_trace_aggr() links the records of each frame and builds per port latency histograms
+//
+// rx: CD_TRACE_DEV_RX -> CD_TRACE_POLL -> CD_TRACE_RECV, tx: CD_TRACE_TX_Q -> CD_TRACE_TX
+// compiled in and disabled (cd_trace == NULL), each point costs one predictable branch
+
+//#define CD_TRACE
+
+#ifndef CD_TRACE_TIME
+#define CD_TRACE_TIME()     get_systick()   // e.g. a cycle counter for sub-systick resolution
+#endif
+#ifndef CD_TRACE_LINK
+#define CD_TRACE_LINK       64              // frames in flight tracked by the aggregator, power of 2
+#endif
+#define CD_TRACE_BKT        24              // histogram buckets: 0, [1, 2), [2, 4) ... [2^22, inf)
+
+typedef enum {
+    CD_TRACE_DEV_RX = 0,    // driver put the frame to rx_head
+    CD_TRACE_POLL,          // cdn_poll parsed the frame
+    CD_TRACE_RECV,          // cdn_sock_recvfrom returned it
+    CD_TRACE_TX_Q,          // cdn_send_frame put it to the tx queue
+    CD_TRACE_TX             // driver took it by cd_tx_get
+} cd_trace_stage_t;
+
+typedef struct {
+    volatile uint32_t seq;  // ring index + 1, written last
+    uint32_t        time;
+    uint32_t        id;     // frame address
+    uint16_t        port;   // 0 at the device layer
+    uint8_t         stage;
+    uint8_t         _reserved;
+} cd_trace_rec_t;
+
+typedef struct {
+    uint16_t        port;
+    uint8_t         stage;  // latency from the previous stage to this stage
+    uint32_t        cnt;
+    uint32_t        max;
+    uint32_t        bkt[CD_TRACE_BKT];
+} cd_trace_hist_t;
+
+typedef struct {
+    cd_trace_rec_t  *recs;
+    uint32_t        num;    // power of 2
+    volatile uint32_t wr;
+    uint32_t        rd;     // aggregator position
+    cd_spinlock_t   lock;   // only for the reservation of wr
+    uint32_t        lost_cnt; // overwritten before aggregated
+
+    struct {
+        uint32_t    id;
+        uint32_t    time;
+        uint16_t    port;
+        uint8_t     stage;
+    } link[CD_TRACE_LINK];  // last record of recent frames, direct-mapped by id
+} cd_trace_t;
+
+extern cd_trace_t *cd_trace; // NULL: disabled
+
+
+void cd_trace_init(cd_trace_t *tr, cd_trace_rec_t *recs, uint32_t num);
+void cd_trace_put(cd_trace_t *tr, uint8_t stage, uint16_t port, const void *frm);
+int cd_trace_aggr(cd_trace_t *tr, cd_trace_hist_t *hists, int num, int used); // return hists used
+uint32_t cd_trace_pct(const cd_trace_hist_t *hist, unsigned pct); // upper bound of the bucket
+
+#ifdef CD_TRACE
+#define cd_trace_pt(stage, port, frm)                           \
+    do {                                                        \
+        if (__builtin_expect(cd_trace != NULL, 0))              \
+            cd_trace_put(cd_trace, stage, port, frm);           \
+    } while (0)
+#else
+#define cd_trace_pt(stage, port, frm)       do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,40 @@
 
 #include "modbus_crc.h"
 
+// polynomials mod p in the crc register form: bit 15 is x^0, bit 0 is x^15
+
+static uint16_t crc16_mulmod(uint16_t a, uint16_t b)
+{
+    uint16_t p = 0;
+    for (uint16_t m = 0x8000; m; m >>= 1) {
+        if (a & m)
+            p ^= b;
+        b = (b & 1) ? (b >> 1) ^ 0xa001 : b >> 1; // b * x
+    }
+    return p;
+}
+
+// x^n mod p
+static uint16_t crc16_xpow(uint32_t n)
+{
+    uint16_t p = 0x8000;
+    uint16_t sq = 0x4000; // x^1, x^2, x^4 ...
+    for (; n; n >>= 1) {
+        if (n & 1)
+            p = crc16_mulmod(p, sq);
+        sq = crc16_mulmod(sq, sq);
+    }
+    return p;
+}
+
+// crc of a | b from crc1 = crc16(a), crc2 = crc16(b), len2: length of b
+uint16_t crc16_combine(uint16_t crc1, uint16_t crc2, uint32_t len2)
+{
+    // crc16_sub(b, crc1) = crc2 ^ (crc1 ^ 0xffff) * x^(8 * len2)
+    return crc2 ^ crc16_mulmod(crc1 ^ 0xffff, crc16_xpow(len2 * 8));
+}
+
+
 #if defined(CD_CRC_NO_TBL)
 
 static inline uint16_t crc16_byte(uint8_t data, uint16_t crc_val)
@@ -61,7 +95,7 @@ uint16_t crc16_sub(const uint8_t *data, uint32_t length, uint16_t crc_val)
 
 #ifdef CD_CRC_GEN_TBL
 static uint16_t crc16_table[256];
-void crc16_table_init(void)
+static void crc16_table_gen(void)
 {
     for (int i = 0; i < 256; i++) {
         uint16_t crc = i;
@@ -107,6 +141,15 @@ static const uint16_t crc16_table[] = {
 };
 #endif
 
+#ifndef CD_CRC_SLICE
+
+#ifdef CD_CRC_GEN_TBL
+void crc16_table_init(void)
+{
+    crc16_table_gen();
+}
+#endif
+
 uint16_t crc16_sub(const uint8_t *data, uint32_t length, uint16_t crc_val)
 {
     while (length--) {
@@ -116,4 +159,236 @@ uint16_t crc16_sub(const uint8_t *data, uint32_t length, uint16_t crc_val)
     }
     return crc_val;
 }
+
+#else // CD_CRC_SLICE
+
+// crc16_table_s[k - 1][i]: crc of byte i followed by k zero bytes, built by crc16_table_init
+static uint16_t crc16_table_s[7][256];
+
+static uint16_t crc16_sub_tbl(const uint8_t *data, uint32_t length, uint16_t crc_val)
+{
+    while (length--) {
+        uint8_t tmp = *data++ ^ crc_val;
+        crc_val >>= 8;
+        crc_val ^= crc16_table[tmp];
+    }
+    return crc_val;
+}
+
+static uint16_t crc16_sub_s4(const uint8_t *data, uint32_t length, uint16_t crc_val)
+{
+    for (; length >= 4; length -= 4, data += 4) {
+        uint32_t w;
+        memcpy(&w, data, 4); // little-endian
+        w ^= crc_val;
+        crc_val = crc16_table_s[2][w & 0xff] ^ crc16_table_s[1][(w >> 8) & 0xff] ^
+                crc16_table_s[0][(w >> 16) & 0xff] ^ crc16_table[w >> 24];
+    }
+    return crc16_sub_tbl(data, length, crc_val);
+}
+
+static uint16_t crc16_sub_s8(const uint8_t *data, uint32_t length, uint16_t crc_val)
+{
+    for (; length >= 8; length -= 8, data += 8) {
+        uint64_t w;
+        memcpy(&w, data, 8);
+        w ^= crc_val;
+        crc_val = crc16_table_s[6][w & 0xff] ^ crc16_table_s[5][(w >> 8) & 0xff] ^
+                crc16_table_s[4][(w >> 16) & 0xff] ^ crc16_table_s[3][(w >> 24) & 0xff] ^
+                crc16_table_s[2][(w >> 32) & 0xff] ^ crc16_table_s[1][(w >> 40) & 0xff] ^
+                crc16_table_s[0][(w >> 48) & 0xff] ^ crc16_table[w >> 56];
+    }
+    return crc16_sub_tbl(data, length, crc_val);
+}
+
+#ifdef CD_CRC_CLMUL
+// fold 128-bit blocks by carry-less multiply, the folded state and the tail by crc16_sub_s8
+//
+// bit i of a little-endian load is the coefficient of x^(127-i) (reflected), and the product of
+// two reflected 64-bit values comes out as x * a * b, so the constants are x^(d+63), x^(d-1) mod p,
+// for folding the low and high half of a block over a distance of d bits
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC16_CLMUL_ATTR    __attribute__((target("pclmul,sse2")))
+typedef __m128i crc16_v_t;
+
+static inline CRC16_CLMUL_ATTR crc16_v_t crc16_v_ld(const uint8_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline CRC16_CLMUL_ATTR crc16_v_t crc16_v_k(uint64_t k_lo, uint64_t k_hi)
+{
+    return _mm_set_epi64x(k_hi, k_lo);
+}
+
+static inline CRC16_CLMUL_ATTR crc16_v_t crc16_v_fold(crc16_v_t x, crc16_v_t k, crc16_v_t d)
+{
+    crc16_v_t lo = _mm_clmulepi64_si128(x, k, 0x00);
+    crc16_v_t hi = _mm_clmulepi64_si128(x, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), d);
+}
+
+static inline CRC16_CLMUL_ATTR void crc16_v_st(uint8_t *p, crc16_v_t x)
+{
+    _mm_storeu_si128((__m128i *)p, x);
+}
+
+#define crc16_clmul_ok()    __builtin_cpu_supports("pclmul")
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_AES)
+#include <arm_neon.h>
+#define CRC16_CLMUL_ATTR
+typedef uint64x2_t crc16_v_t;
+
+static inline crc16_v_t crc16_v_ld(const uint8_t *p)
+{
+    return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+static inline crc16_v_t crc16_v_k(uint64_t k_lo, uint64_t k_hi)
+{
+    return vcombine_u64(vcreate_u64(k_lo), vcreate_u64(k_hi));
+}
+
+static inline crc16_v_t crc16_v_fold(crc16_v_t x, crc16_v_t k, crc16_v_t d)
+{
+    crc16_v_t lo = vreinterpretq_u64_p128(vmull_p64(vgetq_lane_u64(x, 0), vgetq_lane_u64(k, 0)));
+    crc16_v_t hi = vreinterpretq_u64_p128(vmull_high_p64(vreinterpretq_p64_u64(x), vreinterpretq_p64_u64(k)));
+    return veorq_u64(veorq_u64(lo, hi), d);
+}
+
+static inline void crc16_v_st(uint8_t *p, crc16_v_t x)
+{
+    vst1q_u8(p, vreinterpretq_u8_u64(x));
+}
+
+#define crc16_clmul_ok()    true
+
+#else
+#error "CD_CRC_CLMUL requires x86 pclmul or aarch64 pmull"
+#endif
+
+static uint64_t crc16_k128[2], crc16_k512[2];
+
+static CRC16_CLMUL_ATTR uint16_t crc16_sub_clmul(const uint8_t *data, uint32_t length, uint16_t crc_val)
+{
+    if (length < CD_CRC_CLMUL_MIN)
+        return crc16_sub_s8(data, length, crc_val);
+
+    uint8_t buf[16];
+    crc16_v_t k = crc16_v_k(crc16_k512[0], crc16_k512[1]);
+    crc16_v_t x0, x1, x2, x3;
+
+    // xor the crc into the first two bytes, then the crc of the folded state starts from 0
+    memcpy(buf, data, 16);
+    buf[0] ^= crc_val;
+    buf[1] ^= crc_val >> 8;
+    x0 = crc16_v_ld(buf);
+    x1 = crc16_v_ld(data + 16);
+    x2 = crc16_v_ld(data + 32);
+    x3 = crc16_v_ld(data + 48);
+    data += 64;
+    length -= 64;
+
+    for (; length >= 64; length -= 64, data += 64) {
+        x0 = crc16_v_fold(x0, k, crc16_v_ld(data));
+        x1 = crc16_v_fold(x1, k, crc16_v_ld(data + 16));
+        x2 = crc16_v_fold(x2, k, crc16_v_ld(data + 32));
+        x3 = crc16_v_fold(x3, k, crc16_v_ld(data + 48));
+    }
+
+    k = crc16_v_k(crc16_k128[0], crc16_k128[1]);
+    x1 = crc16_v_fold(x0, k, x1);
+    x2 = crc16_v_fold(x1, k, x2);
+    x3 = crc16_v_fold(x2, k, x3);
+    for (; length >= 16; length -= 16, data += 16)
+        x3 = crc16_v_fold(x3, k, crc16_v_ld(data));
+
+    crc16_v_st(buf, x3);
+    crc_val = crc16_sub_s8(buf, 16, 0);
+    return crc16_sub_s8(data, length, crc_val);
+}
+#endif // CD_CRC_CLMUL
+
+crc16_backend_t crc16_backends[] = {
+    { "tbl", crc16_sub_tbl },
+    { "slice4", crc16_sub_s4 },
+    { "slice8", crc16_sub_s8 },
+#ifdef CD_ARCH_CRC_HW
+    { "hw", crc16_hw_sub },
+#endif
+#ifdef CD_CRC_CLMUL
+    { "clmul", crc16_sub_clmul }, // keep last, dropped if the cpu lacks it
+#endif
+};
+int crc16_backend_num = sizeof(crc16_backends) / sizeof(crc16_backends[0]);
+crc16_sub_t crc16_sub_fn = crc16_sub_tbl;
+
+// calls per CD_CRC_SEL_TICKS systick on a typical frame
+static uint32_t crc16_measure(crc16_sub_t sub)
+{
+    static uint8_t buf[64];
+    volatile uint16_t sink = 0;
+    uint32_t cnt = 0;
+    uint32_t t = get_systick();
+    while (get_systick() == t); // align to a tick edge
+    t = get_systick();
+    while (get_systick() - t < CD_CRC_SEL_TICKS) {
+        sink ^= sub(buf, sizeof(buf), 0xffff);
+        cnt++;
+    }
+    return cnt;
+}
+
+// idx < 0: pick the fastest by measurement, return the index selected
+int crc16_select(int idx)
+{
+    if (idx < 0 || idx >= crc16_backend_num) {
+        uint32_t best = 0;
+        for (int i = 0; i < crc16_backend_num; i++) {
+            uint32_t cnt = crc16_measure(crc16_backends[i].sub);
+            if (cnt > best) {
+                best = cnt;
+                idx = i;
+            }
+        }
+    }
+    crc16_sub_fn = crc16_backends[idx].sub;
+    return idx;
+}
+
+// call at startup with systick running, crc16_sub uses the 256 table before
+void crc16_table_init(void)
+{
+#ifdef CD_CRC_GEN_TBL
+    crc16_table_gen();
+#endif
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = crc16_table[i];
+        crc16_table_s[0][i] = (crc >> 8) ^ crc16_table[crc & 0xff];
+    }
+    for (int k = 1; k < 7; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint16_t crc = crc16_table_s[k - 1][i];
+            crc16_table_s[k][i] = (crc >> 8) ^ crc16_table[crc & 0xff];
+        }
+    }
+#ifdef CD_CRC_CLMUL
+    crc16_k128[0] = (uint64_t)crc16_xpow(128 + 63) << 48;
+    crc16_k128[1] = (uint64_t)crc16_xpow(128 - 1) << 48;
+    crc16_k512[0] = (uint64_t)crc16_xpow(512 + 63) << 48;
+    crc16_k512[1] = (uint64_t)crc16_xpow(512 - 1) << 48;
+    if (!crc16_clmul_ok())
+        crc16_backend_num = sizeof(crc16_backends) / sizeof(crc16_backends[0]) - 1;
+#endif
+    crc16_select(-1);
+}
+
+uint16_t crc16_sub(const uint8_t *data, uint32_t length, uint16_t crc_val)
+{
+    return crc16_sub_fn(data, length, crc_val);
+}
+#endif // CD_CRC_SLICE
 #endif
@@ -16,11 +16,45 @@
 extern "C" {
 #endif
 
-#ifdef CD_CRC_GEN_TBL
+// slicing-by-4 / by-8 for 32 / 64-bit hosts (4 KiB tables in ram), and the 256 table version,
+// crc16_table_init() builds the tables and selects the fastest backend (crc16_hw_sub included),
+// call it at startup with systick running (it measures for a few ms), before it the 256 table is used
+//#define CD_CRC_SLICE
+
+// carry-less multiply folding for bulk buffers (x86 pclmul, aarch64 pmull), require CD_CRC_SLICE
+//#define CD_CRC_CLMUL
+#if defined(CD_CRC_CLMUL) && !defined(CD_CRC_SLICE)
+#error "CD_CRC_CLMUL requires CD_CRC_SLICE"
+#endif
+#ifndef CD_CRC_CLMUL_MIN
+#define CD_CRC_CLMUL_MIN    64  // shorter by slicing-by-8, >= 64
+#endif
+
+#ifndef CD_CRC_SEL_TICKS
+#define CD_CRC_SEL_TICKS    2   // measure time of each backend, unit: systick
+#endif
+
+#if defined(CD_CRC_GEN_TBL) || defined(CD_CRC_SLICE)
 void crc16_table_init(void);
 #endif
 
+#ifdef CD_CRC_SLICE
+typedef uint16_t (*crc16_sub_t)(const uint8_t *data, uint32_t length, uint16_t crc_val);
+
+typedef struct {
+    const char      *name;
+    crc16_sub_t     sub;
+} crc16_backend_t;
+
+extern crc16_backend_t crc16_backends[];
+extern int crc16_backend_num;
+extern crc16_sub_t crc16_sub_fn; // selected backend
+
+int crc16_select(int idx);
+#endif
+
 uint16_t crc16_sub(const uint8_t *data, uint32_t length, uint16_t crc_val);
+uint16_t crc16_combine(uint16_t crc1, uint16_t crc2, uint32_t len2);
 
 static inline uint16_t crc16(const uint8_t *data, uint32_t length)
 {